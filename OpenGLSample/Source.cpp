@@ -4,9 +4,6 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -15,14 +12,32 @@
 
 #include "shader.h"
 #include "camera.h"
-
+#include "gl_ext.h"
+#include "ring_buffer.h"
+#include "scene_buffer.h"
+#include "uniform_blocks.h"
+#include "gl_state.h"
+#include "gl_create.h"
+#include "gpu_resources.h"
+#include "mesh_pool.h"
+#include "mesh_cpu_memory.h"
+#include "lod.h"
+#include "mesh_generators.h"
+#include "generator_bench.h"
+#include "baked_meshes.h"
+#include "mesh_rebuilder.h"
+#include "tangent_space.h"
+#include "texture_arrays.h"
+
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <utility>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
-unsigned int loadTexture(const char* path);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -39,6 +54,9 @@ Camera birdEyeCamera(glm::vec3(0.0f, 0.0f, 3.0f));
 bool birdEyeView = false; // Indicates whether bird's eye view is active or not
 bool birdEyeKeyPressed = false;
 
+bool memoryReportKeyPressed = false;
+bool memoryReportRequested = false;
+
 // timing
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
@@ -46,26 +64,122 @@ float lastFrame = 0.0f;
 // lighting
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 
+// vertices and indices live in the shared mesh pool slabs; the VAO is shared with every mesh of the same layout
 struct GLMesh
 {
-	GLuint vao;  // Vertex Array Object
-	GLuint vbo;  // Vertex Buffer Object
-	GLuint cbo;  // Color Buffer Object
-	GLuint ebo;  // Element Buffer Object
-	GLuint tbo;  // Texture Buffer Object
-	GLsizei nIndices;  // Number of indices to be rendered
+	PooledMesh geometry;
+	GLsizei nIndices = 0;  // Number of indices to be rendered
+	std::vector<Meshlet> meshlets;  // culled per frame by the LOD objects
 };
 
-void UCreateCupMesh(GLMesh& mesh);
-void UCreateHandleMesh(GLMesh& mesh);
-void UCreatePlaneMesh(GLMesh& mesh);
-void UCreatePaper1Mesh(GLMesh& mesh);
-void UCreatePaper2Mesh(GLMesh& mesh);
-void UCreatePaper3Mesh(GLMesh& mesh);
-void UCreatePenMesh(GLMesh& mesh);
+// interleaved formats of the procedural meshes; the plane feeds its UVs to location 1
+using PositionNormalUV = VertexFormat<Position3f, Normal3f, TexCoord2f>;
+using PositionUV = VertexFormat<Position3f, Attribute<1, float, 2>>;
+// the light cube reads only the positions of the container's interleaved vertices
+using PositionOnly = VertexFormat<Position3f, Padding<5 * sizeof(float)>>;
+const VertexLayout POSITION_NORMAL_UV = PositionNormalUV::layout();
+const VertexLayout POSITION_UV = PositionUV::layout();
+
+// give the cup, handle and pen tangent frames (tangent_space.h) for normal mapping. Off while no
+// program reads locations 3 and 4: the frames would widen every procedural vertex (packed 16 to
+// 20 bytes, floats 32 to 56) and cost every live rebuild a generateTangents pass for nothing
+const bool PROCEDURAL_TANGENTS = false;
+using PositionNormalUVTangent = VertexFormat<Position3f, Normal3f, TexCoord2f, Tangent3f, Bitangent3f>;
+const VertexLayout PROCEDURAL_LAYOUT = PROCEDURAL_TANGENTS ? PositionNormalUVTangent::layout() : POSITION_NORMAL_UV;
+
+// segment counts of the parametric LOD chains, finest first
+constexpr int LOD_SEGMENTS[] = { 64, 32, 16, 8 };
+// pixel threshold, bias and hysteresis of LOD selection; [ and ] step the bias
+LodSettings lodSettings;
+bool lodBiasKeyPressed = false;
+
+// scratch memory the parametric generators write into, reused by every procedural mesh
+MeshArena generatorArena;
+
+// upload the procedural meshes in the packed vertex format (vertex_quantization.h) instead of 32-bit floats
+const bool PACKED_VERTICES = true;
+// build the LOD levels from the meshes the compiler baked (baked_meshes.h) instead of generating them at startup
+const bool BAKED_LOD_GEOMETRY = true;
+// keep each material's specular intensity in its diffuse map's alpha (texture_arrays.h) and build
+// 6.multiple_lights.fs with PACKED_MATERIAL_MAPS, so it reads a material with one texture() call per fragment
+const bool PACKED_MATERIAL_MAPS = true;
+
+// dimensions of the parametric meshes, shared by the runtime generators and the baked levels
+constexpr float CUP_BOTTOM_RADIUS = 0.4f;
+constexpr float CUP_TOP_RADIUS = 0.5f;
+constexpr float CUP_HEIGHT = 1.0f;
+constexpr float HANDLE_RING_RADIUS = 0.4f;
+constexpr float HANDLE_TUBE_RADIUS = 0.05f;
+constexpr float PEN_RADIUS = 0.05f;
+constexpr float PEN_HEIGHT = 1.0f;
+
+// tube segments of the handle at a LOD level's ring segment count
+constexpr int lodTubeSegments(int segments)
+{
+	return segments / 3 > 4 ? segments / 3 : 4;
+}
 
-int main()
+// the cup, handle and pen of one LOD level, computed by the compiler and kept in read-only data
+template <int Segments>
+struct BakedLodLevel
 {
+	static constexpr auto cup = bakeFrustum<Segments>(CUP_BOTTOM_RADIUS, CUP_TOP_RADIUS, CUP_HEIGHT);
+	static constexpr auto handle = bakeTorus<Segments, lodTubeSegments(Segments)>(HANDLE_RING_RADIUS, HANDLE_TUBE_RADIUS);
+	static constexpr auto pen = bakeFrustum<Segments>(PEN_RADIUS, PEN_RADIUS, PEN_HEIGHT);
+};
+
+// live dimensions of the cup and handle; the baked levels match the defaults, every edit rebuilds
+// the chain on a worker thread while the old one keeps drawing
+struct ShapeParameters
+{
+	float cupBottomRadius = CUP_BOTTOM_RADIUS;
+	float cupTopRadius = CUP_TOP_RADIUS;
+	float cupHeight = CUP_HEIGHT;
+	int cupSegments = LOD_SEGMENTS[0];
+	float handleRingRadius = HANDLE_RING_RADIUS;
+	float handleTubeRadius = HANDLE_TUBE_RADIUS;
+	int handleRingSegments = LOD_SEGMENTS[0];
+	int handleTubeSegments = lodTubeSegments(LOD_SEGMENTS[0]);
+};
+ShapeParameters shapeParameters;
+bool cupShapeChanged = false;
+bool handleShapeChanged = false;
+bool shapeKeyPressed = false;
+// finest segment counts an edit can reach; the handle's tube stops at its own limit
+const int MAX_LIVE_SEGMENTS = 16384;
+const int MAX_LIVE_TUBE_SEGMENTS = 32;
+
+void UAddMesh(MeshPool& pool, GLMesh& mesh, const VertexLayout& layout, IndexedMesh processed);
+void UCreateCupMesh(MeshPool& pool, GLMesh& mesh, int numSegments = 50);
+void UCreateHandleMesh(MeshPool& pool, GLMesh& mesh, int torusSegments = 50, int tubeSegments = 20);
+void UCreatePlaneMesh(MeshPool& pool, GLMesh& mesh);
+void UCreatePaper1Mesh(MeshPool& pool, GLMesh& mesh);
+void UCreatePaper2Mesh(MeshPool& pool, GLMesh& mesh);
+void UCreatePaper3Mesh(MeshPool& pool, GLMesh& mesh);
+void UCreatePenMesh(MeshPool& pool, GLMesh& mesh, int numSegments = 50);
+IndexedMesh UWithTangents(IndexedMesh processed);
+IndexedMesh UGenerateCupMesh(MeshArena& arena, float bottomRadius, float topRadius, float height, int numSegments);
+IndexedMesh UGenerateHandleMesh(MeshArena& arena, float ringRadius, float tubeRadius, int torusSegments, int tubeSegments);
+int ULodSegments(int segments, size_t level, int minimum);
+PreparedChain UPrepareCupChain(const ShapeParameters& shape);
+PreparedChain UPrepareHandleChain(const ShapeParameters& shape);
+void UEditShape(int key);
+template <typename Baked>
+void UAddBakedMesh(MeshPool& pool, GLMesh& mesh, const Baked& baked);
+template <size_t... Levels>
+void UCreateLodChains(MeshPool& pool, LodChain& cups, LodChain& handles, LodChain& pens, std::index_sequence<Levels...>);
+template <size_t Level>
+void UCreateLodLevel(MeshPool& pool, LodChain& cups, LodChain& handles, LodChain& pens);
+
+int main(int argc, char** argv)
+{
+	// --bench: time the mesh generators against the loops they replaced; needs no window
+	if (argc > 1 && std::string(argv[1]) == "--bench")
+	{
+		runGeneratorBenchmark(std::cout);
+		return 0;
+	}
+
 	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
@@ -101,15 +215,26 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	loadGLExtensions((GLADloadproc)glfwGetProcAddress);
 
 	// configure global opengl state
 	// -----------------------------
-	glEnable(GL_DEPTH_TEST);
+	glState().enable(GL_DEPTH_TEST);
 
 	// build and compile our shader zprogram
 	// ------------------------------------
-	Shader lightingShader("shaderfiles/6.multiple_lights.vs", "shaderfiles/6.multiple_lights.fs");
+	Shader lightingShader("shaderfiles/6.multiple_lights.vs", "shaderfiles/6.multiple_lights.fs", nullptr,
+		PACKED_MATERIAL_MAPS ? "#define PACKED_MATERIAL_MAPS\n" : "");
 	Shader lightCubeShader("shaderfiles/6.light_cube.vs", "shaderfiles/6.light_cube.fs");
+	lightingShader.setBlockBinding("FrameConstants", FRAME_CONSTANTS_BINDING);
+	lightingShader.setBlockBinding("SpotLightBlock", SPOTLIGHT_BINDING);
+	lightingShader.setBlockBinding("LightsBlock", LIGHTS_BINDING);
+	lightCubeShader.setBlockBinding("FrameConstants", FRAME_CONSTANTS_BINDING);
+
+	// per-frame data is streamed through a triple-buffered ring instead of individual glUniform calls
+	GLint uniformAlignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	RingBuffer* frameRing = new RingBuffer(GL_UNIFORM_BUFFER, 64 * 1024);
 
 	// set up vertex data (and buffer(s)) and configure vertex attributes
 	// ------------------------------------------------------------------
@@ -134,70 +259,167 @@ int main()
 		glm::vec3(-4.0f,  2.0f, -12.0f),
 		glm::vec3(0.0f,  0.0f, -3.0f)
 	};
+	// the directional and point lights never change, so their block is uploaded once
+	LightsBlock lights = {};
+	lights.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+	lights.dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+	lights.dirLight.diffuse = glm::vec3(0.4f, 0.4f, 0.4f);
+	lights.dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
+	for (int i = 0; i < NR_POINT_LIGHTS; i++)
+	{
+		lights.pointLights[i].position = pointLightPositions[i];
+		lights.pointLights[i].ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+		lights.pointLights[i].diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+		lights.pointLights[i].specular = glm::vec3(1.0f, 1.0f, 1.0f);
+		lights.pointLights[i].constant = 1.0f;
+		lights.pointLights[i].linear = 0.09f;
+		lights.pointLights[i].quadratic = 0.032f;
+	}
+	GpuResource lightsUBO = makeBuffer(MemoryCategory::Uniform, sizeof(LightsBlock), &lights, 0, "lights");
+	glState().bindBufferBase(GL_UNIFORM_BUFFER, LIGHTS_BINDING, lightsUBO.id());
+
 	// first, configure the cube's VAO (and VBO)
 	unsigned int VBO, cubeVAO;
 	glGenVertexArrays(1, &cubeVAO);
 	glGenBuffers(1, &VBO);
 
 
-	glBindVertexArray(cubeVAO);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
+	glState().bindVertexArray(cubeVAO);
+	PositionNormalUV::setup();
 
 	// second, configure the light's VAO (VBO stays the same; the vertices are the same for the light object which is also a 3D cube)
 	unsigned int lightCubeVAO;
 	glGenVertexArrays(1, &lightCubeVAO);
-	glBindVertexArray(lightCubeVAO);
+	glState().bindVertexArray(lightCubeVAO);
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
 	// note that we update the lamp's position attribute's stride to reflect the updated buffer data
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	// load textures (we now use a utility function to keep the code more organized)
-	// -----------------------------------------------------------------------------
-	unsigned int diffuseMap = loadTexture("marbleTex.jpg");
-	unsigned int specularMap = loadTexture("marbleTex.jpg");
-	unsigned int woodTexture = loadTexture("woodTex.jpg");
-	unsigned int paperTexture = loadTexture("paperTex.jpg");
-	unsigned int penTexture = loadTexture("penTex.jpg");
+	PositionOnly::setup();
+
+	// load textures: all four images have the same format, so resized to one size they fill a
+	// single array texture and objects pick their maps by layer, with no texture binds between draws.
+	// Resize takes the smallest of them, 1280x853 (wood and pen): the paper, 1280x1280, is scaled
+	// down and the marble loses three rows, rather than three images being blown up to the paper's.
+	// Every object uses the marble as its specular map; packed, it goes into each diffuse map's alpha.
+	// -----------------------------------------------------------------------------------------------
+	TexturePacker texturePacker;
+	const char* specularPath = "marbleTex.jpg";
+	int marbleImage = PACKED_MATERIAL_MAPS ? texturePacker.add("marbleTex.jpg", specularPath) : texturePacker.add("marbleTex.jpg");
+	int woodImage = PACKED_MATERIAL_MAPS ? texturePacker.add("woodTex.jpg", specularPath) : texturePacker.add("woodTex.jpg");
+	int paperImage = PACKED_MATERIAL_MAPS ? texturePacker.add("paperTex.jpg", specularPath) : texturePacker.add("paperTex.jpg");
+	int penImage = PACKED_MATERIAL_MAPS ? texturePacker.add("penTex.jpg", specularPath) : texturePacker.add("penTex.jpg");
+	texturePacker.pack();
+
+	const TextureLayer MAP_MARBLE = texturePacker.layer(marbleImage);
+	// the packed shader never reads the specular map, it is in the diffuse alpha
+	const TextureLayer MAP_MARBLE_SPECULAR = PACKED_MATERIAL_MAPS ? TextureLayer() : MAP_MARBLE;
+	const TextureLayer MAP_WOOD = texturePacker.layer(woodImage);
+	const TextureLayer MAP_PAPER = texturePacker.layer(paperImage);
+	const TextureLayer MAP_PEN = texturePacker.layer(penImage);
+	// every array keeps its own texture unit for the whole run
+	const unsigned int MATERIAL_ARRAY_UNITS = 4;    // NR_MATERIAL_ARRAYS in 6.multiple_lights.fs
+	const unsigned int OBJECT_RECORDS_UNIT = MATERIAL_ARRAY_UNITS;
+	if (texturePacker.arrayCount() > MATERIAL_ARRAY_UNITS)
+		std::cout << "ERROR::TEXTURE_PACKER::TOO_MANY_ARRAYS " << texturePacker.arrayCount() << " arrays, the shader samples " << MATERIAL_ARRAY_UNITS << std::endl;
+	texturePacker.bind(0);
 
 	// shader configuration
 	// --------------------
 	lightingShader.use();
-	lightingShader.setInt("material.diffuse", 0);
-	lightingShader.setInt("material.specular", 1);
-
-	lightingShader.setInt("material.diffuse", 2);  // Use the appropriate texture unit index (e.g., GL_TEXTURE2)
-
-
-	GLMesh cupMesh;
-	UCreateCupMesh(cupMesh);
-
-	GLMesh handleMesh;
-	UCreateHandleMesh(handleMesh);
+	for (unsigned int i = 0; i < MATERIAL_ARRAY_UNITS; i++)
+		lightingShader.setInt("materialArrays[" + std::to_string(i) + "]", i);
+	lightingShader.setInt("objectRecords", OBJECT_RECORDS_UNIT);
+
+	// every procedural mesh is packed into a few shared slabs instead of owning buffers of its own
+	MeshPool* meshPool = new MeshPool();
+
+	// the cup, handle and pen are parametric: each gets a chain of levels in the same slabs,
+	// tagged with how far the polygon strays from the true circle
+	LodChain cupLods, handleLods, penLods;
+	UCreateLodChains(*meshPool, cupLods, handleLods, penLods, std::make_index_sequence<std::size(LOD_SEGMENTS)>());
+	// bounding spheres as UPrepareCupChain and UPrepareHandleChain compute them, from the same dimensions
+	cupLods.radius = glm::length(glm::vec2(std::max(CUP_BOTTOM_RADIUS, CUP_TOP_RADIUS), CUP_HEIGHT * 0.5f));
+	handleLods.radius = HANDLE_RING_RADIUS + HANDLE_TUBE_RADIUS;
+	penLods.radius = glm::length(glm::vec2(PEN_RADIUS, PEN_HEIGHT * 0.5f));
 
 	GLMesh planeMesh;
-	UCreatePlaneMesh(planeMesh);
+	UCreatePlaneMesh(*meshPool, planeMesh);
 
 	GLMesh paper1Mesh;
-	UCreatePaper1Mesh(paper1Mesh);
+	UCreatePaper1Mesh(*meshPool, paper1Mesh);
 
 	GLMesh paper2Mesh;
-	UCreatePaper2Mesh(paper2Mesh);
+	UCreatePaper2Mesh(*meshPool, paper2Mesh);
 
 	GLMesh paper3Mesh;
-	UCreatePaper2Mesh(paper3Mesh);
-
-	GLMesh penMesh;
-	UCreatePenMesh(penMesh);
+	UCreatePaper2Mesh(*meshPool, paper3Mesh);
+
+	// paper2/paper3 are the same mesh and the cup and pen share their cylinder topology
+	meshProcessingStats().report(std::cout);
+	meshPool->report(std::cout);
+
+	// scene objects: transforms and materials live on the GPU and are only re-uploaded when edited
+	// ----------------------------------------------------------------------------------------------
+	SceneBuffer* scene = new SceneBuffer(64);
+	glm::mat4 handleModel = glm::mat4(1.0f);
+	handleModel = glm::rotate(handleModel, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	handleModel = glm::translate(handleModel, glm::vec3(-0.5f, -1.0f, 0.0f));
+	glm::mat4 penModel = glm::mat4(1.0f);
+	penModel = glm::rotate(penModel, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	penModel = glm::translate(penModel, glm::vec3(-2.0f, 0.7f, 0.45f));
+	glm::mat4 planeModel = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	glm::mat4 cupModel = glm::translate(glm::mat4(1.0f), glm::vec3(-1.0f, 0.0f, -1.0f));
+
+	int containerObject = scene->add(glm::mat4(1.0f), MAP_WOOD, MAP_MARBLE_SPECULAR, 32.0f);
+	int cupObject = scene->add(cupModel, MAP_MARBLE, MAP_MARBLE_SPECULAR, 32.0f);
+	int handleObject = scene->add(handleModel, MAP_MARBLE, MAP_MARBLE_SPECULAR, 32.0f);
+	int planeObject = scene->add(planeModel, MAP_WOOD, MAP_MARBLE_SPECULAR, 32.0f);
+	int paper1Object = scene->add(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, -0.5f, 0.0f)), MAP_PAPER, MAP_MARBLE_SPECULAR, 32.0f);
+	int paper2Object = scene->add(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, -0.5f, 0.0f)), MAP_PAPER, MAP_MARBLE_SPECULAR, 32.0f);
+	int paper3Object = scene->add(glm::translate(glm::mat4(1.0f), glm::vec3(-0.5f, -0.5f, 1.0f)), MAP_PAPER, MAP_MARBLE_SPECULAR, 32.0f);
+	int paper4Object = scene->add(glm::translate(glm::mat4(1.0f), glm::vec3(-1.5f, -0.5f, 1.0f)), MAP_PAPER, MAP_MARBLE_SPECULAR, 32.0f);
+	int penObject = scene->add(penModel, MAP_PEN, MAP_MARBLE_SPECULAR, 32.0f);
+	// tell the shader how each object's mesh is packed
+	scene->setVertexDecode(cupObject, cupLods.levels[0].geometry.decode);
+	scene->setVertexDecode(handleObject, handleLods.levels[0].geometry.decode);
+	scene->setVertexDecode(planeObject, planeMesh.geometry.decode);
+	scene->setVertexDecode(paper1Object, paper1Mesh.geometry.decode);
+	scene->setVertexDecode(paper2Object, paper2Mesh.geometry.decode);
+	scene->setVertexDecode(paper3Object, paper3Mesh.geometry.decode);
+	scene->setVertexDecode(paper4Object, paper3Mesh.geometry.decode);
+	scene->setVertexDecode(penObject, penLods.levels[0].geometry.decode);
+
+	// edits to the cup and handle are built off the render thread and swapped in when uploaded
+	ChainRebuilder* cupRebuilder = new ChainRebuilder();
+	ChainRebuilder* handleRebuilder = new ChainRebuilder();
+
+	// objects drawn from a LOD chain, with the level each drew last frame
+	struct LodObject
+	{
+		const LodChain* chain;
+		glm::mat4 model;
+		int object;
+		int level;
+	};
+	LodObject cup = { &cupLods, cupModel, cupObject, 0 };
+	LodObject handle = { &handleLods, handleModel, handleObject, 0 };
+	LodObject pen = { &penLods, penModel, penObject, 0 };
+	LodObject* lodObjects[] = { &cup, &handle, &pen };
+	scene->upload();
+	scene->bind(OBJECT_RECORDS_UNIT);
+
+	// every pool VAO gets the object index stream, including those made later for rebuilt chains
+	meshPool->setVertexArraySetup([scene]() { scene->setupObjectIndexAttribute(); });
+	glState().bindVertexArray(cubeVAO);
+	scene->setupObjectIndexAttribute();
+	glState().bindVertexArray(0);
 
 	// render loop
 	// -----------
+	float lastStatsUpdate = 0.0f;
+	MeshletDrawList meshletDraws;   // reused by every LOD object, every frame
+	unsigned int meshletsCulled = 0;
 	while (!glfwWindowShouldClose(window))
 	{
 		// per-frame time logic
@@ -215,59 +437,32 @@ int main()
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		frameRing->beginFrame();
+		// delete whatever was released in frames the GPU has finished
+		gpuResources().collect();
+
 		// be sure to activate shader when setting uniforms/drawing objects
 		lightingShader.use();
-		lightingShader.setVec3("viewPos", camera.Position);
-		lightingShader.setFloat("material.shininess", 32.0f);
-
-		// directional light
-		lightingShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-		lightingShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-		lightingShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-		// point light 1
-		lightingShader.setVec3("pointLights[0].position", pointLightPositions[0]);
-		lightingShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-		lightingShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-		lightingShader.setFloat("pointLights[0].constant", 1.0f);
-		lightingShader.setFloat("pointLights[0].linear", 0.09);
-		lightingShader.setFloat("pointLights[0].quadratic", 0.032);
-		// point light 2
-		lightingShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-		lightingShader.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-		lightingShader.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-		lightingShader.setFloat("pointLights[1].constant", 1.0f);
-		lightingShader.setFloat("pointLights[1].linear", 0.09);
-		lightingShader.setFloat("pointLights[1].quadratic", 0.032);
-		// point light 3
-		lightingShader.setVec3("pointLights[2].position", pointLightPositions[2]);
-		lightingShader.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-		lightingShader.setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-		lightingShader.setFloat("pointLights[2].constant", 1.0f);
-		lightingShader.setFloat("pointLights[2].linear", 0.09);
-		lightingShader.setFloat("pointLights[2].quadratic", 0.032);
-		// point light 4
-		lightingShader.setVec3("pointLights[3].position", pointLightPositions[3]);
-		lightingShader.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-		lightingShader.setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-		lightingShader.setFloat("pointLights[3].constant", 1.0f);
-		lightingShader.setFloat("pointLights[3].linear", 0.09);
-		lightingShader.setFloat("pointLights[3].quadratic", 0.032);
-		// spotLight
-		lightingShader.setVec3("spotLight.position", camera.Position);
-		lightingShader.setVec3("spotLight.direction", camera.Front);
-		lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.1f);
-		lightingShader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.5f);
-		lightingShader.setVec3("spotLight.specular", 0.0f, 0.0f, 0.5f);
-		lightingShader.setFloat("spotLight.constant", 1.0f);
-		lightingShader.setFloat("spotLight.linear", 0.09);
-		lightingShader.setFloat("spotLight.quadratic", 0.032);
-		lightingShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-		lightingShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+
+		// spotLight (built on the stack and copied in one go, the mapped memory is write-combined)
+		SpotLightBlock spotLight = {};
+		spotLight.position = camera.Position;
+		spotLight.direction = camera.Front;
+		spotLight.ambient = glm::vec3(0.0f, 0.0f, 0.1f);
+		spotLight.diffuse = glm::vec3(0.0f, 0.0f, 0.5f);
+		spotLight.specular = glm::vec3(0.0f, 0.0f, 0.5f);
+		spotLight.constant = 1.0f;
+		spotLight.linear = 0.09f;
+		spotLight.quadratic = 0.032f;
+		spotLight.cutOff = glm::cos(glm::radians(12.5f));
+		spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+		RingAllocation spotLightRange = frameRing->allocate(sizeof(SpotLightBlock), uniformAlignment);
+		if (spotLightRange.ptr)
+		{
+			memcpy(spotLightRange.ptr, &spotLight, sizeof(SpotLightBlock));
+			frameRing->flush();
+			glState().bindBufferRange(GL_UNIFORM_BUFFER, SPOTLIGHT_BINDING, frameRing->ID, spotLightRange.offset, spotLightRange.size);
+		}
 
 		// view/projection transformations
 		glm::mat4 view = (birdEyeView ? birdEyeCamera.GetViewMatrix() : camera.GetViewMatrix());
@@ -279,133 +474,121 @@ int main()
 			view = birdEyeCamera.GetViewMatrix();
 		}
 
-		lightingShader.setMat4("view", view);
-		lightingShader.setMat4("projection", projection);
+		// camera data goes up once per frame, whatever number of programs read it
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		FrameConstants frame;
+		frame.view = view;
+		frame.projection = projection;
+		frame.viewProjection = projection * view;
+		frame.cameraPosition = glm::vec4(birdEyeView ? birdEyeCamera.Position : camera.Position, 1.0f);
+		frame.time = currentFrame;
+		frame.deltaTime = deltaTime;
+		frame.resolution = glm::vec2((float)framebufferWidth, (float)framebufferHeight);
+		RingAllocation frameRange = frameRing->allocate(sizeof(FrameConstants), uniformAlignment);
+		if (frameRange.ptr)
+		{
+			memcpy(frameRange.ptr, &frame, sizeof(FrameConstants));
+			frameRing->flush();
+			glState().bindBufferRange(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, frameRing->ID, frameRange.offset, frameRange.size);
+		}
 
-		// world transformation
-		glm::mat4 model = glm::mat4(1.0f);
-		lightingShader.setMat4("model", model);
+		// queue shape edits and swap in chains whose upload has completed; a swapped object
+		// selects its level afresh below
+		if (cupShapeChanged)
+		{
+			cupRebuilder->request([shape = shapeParameters]() { return UPrepareCupChain(shape); });
+			cupShapeChanged = false;
+		}
+		if (handleShapeChanged)
+		{
+			handleRebuilder->request([shape = shapeParameters]() { return UPrepareHandleChain(shape); });
+			handleShapeChanged = false;
+		}
+		if (cupRebuilder->update(*meshPool, cupLods))
+			cup.level = -1;
+		if (handleRebuilder->update(*meshPool, handleLods))
+			handle.level = -1;
+
+		// pick this frame's detail levels; a switch re-points the object at the level's vertex decode
+		LodView lodView = makeLodView(glm::vec3(frame.cameraPosition), projection, (float)framebufferHeight, 0.1f);
+		for (LodObject* lodObject : lodObjects)
+		{
+			int level = selectLod(*lodObject->chain, lodObject->model, lodView, lodSettings, lodObject->level);
+			if (level != lodObject->level)
+			{
+				lodObject->level = level;
+				scene->setVertexDecode(lodObject->object, lodObject->chain->levels[level].geometry.decode);
+			}
+		}
 
-		// bind diffuse map
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, diffuseMap);
-		// bind specular map
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, specularMap);
-		// Bind the plane's texture to a texture unit (e.g., GL_TEXTURE3)
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, woodTexture);  // Bind wood texture to unit 2
+		// per-object edits since last frame, if any
+		scene->upload();
 
 		// render containers
-		glBindVertexArray(cubeVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-
-
-		// Render cup mesh with translation
-		glm::mat4 cupModel = glm::mat4(1.0f);
-		cupModel = glm::translate(cupModel, glm::vec3(-1.0f, 0.0f, -1.0f));
-		lightingShader.setMat4("model", cupModel);
-
-		// render cup
-		lightingShader.setInt("material.diffuse", 0);
-		lightingShader.setInt("material.specular", 1);
-
-		glBindVertexArray(cupMesh.vao);
-		glDrawElements(GL_TRIANGLES, cupMesh.nIndices, GL_UNSIGNED_INT, 0);
-
-		// render handle with translation and rotation
-		glm::mat4 handleModel = glm::mat4(1.0f); // Identity matrix
-		handleModel = glm::rotate(handleModel, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		handleModel = glm::translate(handleModel, glm::vec3(-0.5f, -1.0f, 0.0f));
-		lightingShader.setMat4("model", handleModel);
-
-		lightingShader.setInt("material.diffuse", 0);
-		lightingShader.setInt("material.specular", 1);
-
-		glBindVertexArray(handleMesh.vao);
-		glDrawElements(GL_TRIANGLES, handleMesh.nIndices, GL_UNSIGNED_INT, 0);
-
-		
-
-		
-
-		// Render plane with rotation
-		glm::mat4 planeModel = glm::mat4(1.0f); // Identity matrix
-		planeModel = glm::rotate(planeModel, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		lightingShader.setMat4("model", planeModel);
-		// Set the plane's texture uniform in the shader
-		lightingShader.setInt("material.diffuse", 2);
-		glBindVertexArray(planeMesh.vao);
-		glDrawElements(GL_TRIANGLES, planeMesh.nIndices, GL_UNSIGNED_INT, 0);
-
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, paperTexture);
-
-		// Translate the cube's position
-		glm::mat4 cubeModel = glm::mat4(1.0f);
-		cubeModel = glm::translate(cubeModel, glm::vec3(1.0f, -0.5f, 0.0f));
-		lightingShader.setMat4("model", cubeModel);
-
-		// Set the cube's texture uniform in the shader
-		lightingShader.setInt("material.diffuse", 2);
-
-		// Render the cube
-		glBindVertexArray(paper1Mesh.vao);
-		glDrawArrays(GL_TRIANGLES, 0, paper1Mesh.nIndices);
-
-		// Translate the cube's position
-		glm::mat4 paperModel1 = glm::mat4(1.0f);
-		paperModel1 = glm::translate(paperModel1, glm::vec3(1.0f, -0.5f, 0.0f));
-		lightingShader.setMat4("model", paperModel1);
-
-		// Set the cube's texture uniform in the shader
-		lightingShader.setInt("material.diffuse", 2);
-
-		// Render the cube
-		glBindVertexArray(paper2Mesh.vao);
-		glDrawArrays(GL_TRIANGLES, 0, paper2Mesh.nIndices);
-
-		// Translate the cube's position
-		glm::mat4 paperModel2 = glm::mat4(1.0f);
-		paperModel2 = glm::translate(paperModel2, glm::vec3(-0.5f, -0.5f, 1.0f));
-		lightingShader.setMat4("model", paperModel2);
-
-		// Set the cube's texture uniform in the shader
-		lightingShader.setInt("material.diffuse", 2);
-
-		// Render the cube
-		glBindVertexArray(paper3Mesh.vao);
-		glDrawArrays(GL_TRIANGLES, 0, paper3Mesh.nIndices);
-
-
-		// Translate the cube's position
-		glm::mat4 paperModel3 = glm::mat4(1.0f);
-		paperModel3 = glm::translate(paperModel3, glm::vec3(-1.5f, -0.5f, 1.0f));
-		lightingShader.setMat4("model", paperModel3);
+		glState().bindVertexArray(cubeVAO);
+		scene->drawArrays(GL_TRIANGLES, 0, 36, containerObject);
+
+		// render cup, handle and pen at their selected levels, minus the meshlets outside the
+		// frustum or facing away from the camera
+		MeshletView meshletView = makeMeshletView(frame.viewProjection, glm::vec3(frame.cameraPosition));
+		meshletsCulled = 0;
+		for (LodObject* lodObject : lodObjects)
+		{
+			const LodLevel& level = lodObject->chain->levels[lodObject->level];
+			glState().bindVertexArray(level.geometry.vertexArray);
+			meshletDraws.clear();
+			cullMeshlets(level.meshlets, lodObject->model, meshletView, meshPool->indexOffset(level.geometry),
+				level.geometry.indexType == GL_UNSIGNED_SHORT ? 2 : 4, meshletDraws);
+			meshletsCulled += meshletDraws.frustumCulled + meshletDraws.backfaceCulled;
+			scene->multiDrawElementsBaseVertex(GL_TRIANGLES, meshletDraws.counts.data(), level.geometry.indexType, meshletDraws.offsets.data(),
+				(GLsizei)meshletDraws.counts.size(), meshPool->baseVertex(level.geometry), lodObject->object);
+		}
 
-		// Set the cube's texture uniform in the shader
-		lightingShader.setInt("material.diffuse", 2);
+		// render plane
+		glState().bindVertexArray(planeMesh.geometry.vertexArray);
+		scene->drawElementsBaseVertex(GL_TRIANGLES, planeMesh.nIndices, planeMesh.geometry.indexType, meshPool->indexOffset(planeMesh.geometry), meshPool->baseVertex(planeMesh.geometry), planeObject);
 
-		// Render the cube
-		glBindVertexArray(paper3Mesh.vao);
-		glDrawArrays(GL_TRIANGLES, 0, paper3Mesh.nIndices);
+		// render papers
+		glState().bindVertexArray(paper1Mesh.geometry.vertexArray);
+		scene->drawElementsBaseVertex(GL_TRIANGLES, paper1Mesh.nIndices, paper1Mesh.geometry.indexType, meshPool->indexOffset(paper1Mesh.geometry), meshPool->baseVertex(paper1Mesh.geometry), paper1Object);
 
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, penTexture);
+		glState().bindVertexArray(paper2Mesh.geometry.vertexArray);
+		scene->drawElementsBaseVertex(GL_TRIANGLES, paper2Mesh.nIndices, paper2Mesh.geometry.indexType, meshPool->indexOffset(paper2Mesh.geometry), meshPool->baseVertex(paper2Mesh.geometry), paper2Object);
 
-		// Translate the cube's position
-		glm::mat4 penModel = glm::mat4(1.0f);
-		penModel = glm::rotate(penModel, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		penModel = glm::translate(penModel, glm::vec3(-2.0f, 0.7f, 0.45f));
-		lightingShader.setMat4("model", penModel);
+		glState().bindVertexArray(paper3Mesh.geometry.vertexArray);
+		scene->drawElementsBaseVertex(GL_TRIANGLES, paper3Mesh.nIndices, paper3Mesh.geometry.indexType, meshPool->indexOffset(paper3Mesh.geometry), meshPool->baseVertex(paper3Mesh.geometry), paper3Object);
+		scene->drawElementsBaseVertex(GL_TRIANGLES, paper3Mesh.nIndices, paper3Mesh.geometry.indexType, meshPool->indexOffset(paper3Mesh.geometry), meshPool->baseVertex(paper3Mesh.geometry), paper4Object);
 
-		// Set the cube's texture uniform in the shader
-		lightingShader.setInt("material.diffuse", 4);
+		// frames with time to spare compact the mesh slabs a little
+		if (deltaTime < 1.0f / 120.0f)
+			meshPool->defragment(256 * 1024);
 
+		frameRing->endFrame();
+		gpuResources().endFrame();
+		scene->endFrame();
 
-		glBindVertexArray(penMesh.vao);
-		glDrawElements(GL_TRIANGLES, penMesh.nIndices, GL_UNSIGNED_INT, 0);
+		if (memoryReportRequested)
+		{
+			gpuResources().report(std::cout, true);
+			meshPool->report(std::cout);
+			meshCpuMemory().report(std::cout);
+			memoryReportRequested = false;
+		}
 
+		// once a second, show how many state changes reached the driver and how many were skipped
+		if (currentFrame - lastStatsUpdate >= 1.0f)
+		{
+			const GLStateStats& stats = glState().lastFrame();
+			const SceneDrawStats& draws = scene->lastFrame();
+			std::string title = "Nate Bennett | GL state calls: " + std::to_string(stats.issued) + " issued, " + std::to_string(stats.elided) + " elided"
+				+ " | " + std::to_string(draws.triangles) + " triangles in " + std::to_string(draws.draws) + " draws, LOD bias " + std::to_string((int)lodSettings.bias)
+				+ ", " + std::to_string(meshletsCulled) + " meshlets culled"
+				+ (cupRebuilder->busy() || handleRebuilder->busy() ? ", rebuilding" : "");
+			glfwSetWindowTitle(window, title.c_str());
+			lastStatsUpdate = currentFrame;
+		}
+		glState().endFrame();
 
 
 
@@ -424,6 +607,14 @@ int main()
 	glDeleteVertexArrays(1, &cubeVAO);
 	glDeleteVertexArrays(1, &lightCubeVAO);
 	glDeleteBuffers(1, &VBO);
+	delete cupRebuilder;
+	delete handleRebuilder;
+	delete frameRing;
+	delete scene;
+	delete meshPool;
+	// everything still owned (meshes, textures, shaders) is deleted now, while the context exists
+	gpuResources().report(std::cout);
+	gpuResources().shutdown();
 
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
@@ -431,228 +622,181 @@ int main()
 	return 0;
 }
 
-void UCreateCupMesh(GLMesh& mesh) {
-	float baseRadius = 0.4f;
-	float topRadius = 0.5f;
-	float height = 1.0f;
-	int numSegments = 50;
-
-	int numVertices = (numSegments + 1) * 2 + 2;  // Additional vertices for the top and bottom centers
-	int numIndices = numSegments * 6 + numSegments * 3 * 2;  // Additional indices for the top and bottom faces
-
-	float* vertices = new float[numVertices * 8];
-	unsigned int* indices = new unsigned int[numIndices];
-
-	// Generate vertices and indices
-	for (int i = 0; i <= numSegments; ++i) {
-		float angle = 2.0f * glm::pi<float>() * static_cast<float>(i) / static_cast<float>(numSegments);
-		float x = cos(angle);
-		float z = sin(angle);
-
-		// Calculate vertex positions for the bottom base
-		vertices[i * 8] = x * baseRadius;
-		vertices[i * 8 + 1] = -height / 2.0f;
-		vertices[i * 8 + 2] = z * baseRadius;
-		vertices[i * 8 + 3] = x;
-		vertices[i * 8 + 4] = 0.0f;
-		vertices[i * 8 + 5] = z;
-		vertices[i * 8 + 6] = static_cast<float>(i) / static_cast<float>(numSegments);
-		vertices[i * 8 + 7] = 0.0f;
-
-		// Calculate vertex positions for the top base
-		vertices[(i + numSegments + 1) * 8] = x * topRadius;
-		vertices[(i + numSegments + 1) * 8 + 1] = height / 2.0f;
-		vertices[(i + numSegments + 1) * 8 + 2] = z * topRadius;
-		vertices[(i + numSegments + 1) * 8 + 3] = x;
-		vertices[(i + numSegments + 1) * 8 + 4] = 0.0f;
-		vertices[(i + numSegments + 1) * 8 + 5] = z;
-		vertices[(i + numSegments + 1) * 8 + 6] = static_cast<float>(i) / static_cast<float>(numSegments);
-		vertices[(i + numSegments + 1) * 8 + 7] = 1.0f;
-	}
-
-	// Add vertices for the top and bottom centers
-	int centerBottomIndex = numVertices - 2;
-	int centerTopIndex = numVertices - 1;
-	vertices[centerBottomIndex * 8] = 0.0f;
-	vertices[centerBottomIndex * 8 + 1] = -height / 2.0f;
-	vertices[centerBottomIndex * 8 + 2] = 0.0f;
-	vertices[centerBottomIndex * 8 + 3] = 0.0f;
-	vertices[centerBottomIndex * 8 + 4] = -1.0f;
-	vertices[centerBottomIndex * 8 + 5] = 0.0f;
-	vertices[centerBottomIndex * 8 + 6] = 0.5f;
-	vertices[centerBottomIndex * 8 + 7] = 0.0f;
-
-	vertices[centerTopIndex * 8] = 0.0f;
-	vertices[centerTopIndex * 8 + 1] = height / 2.0f;
-	vertices[centerTopIndex * 8 + 2] = 0.0f;
-	vertices[centerTopIndex * 8 + 3] = 0.0f;
-	vertices[centerTopIndex * 8 + 4] = 1.0f;
-	vertices[centerTopIndex * 8 + 5] = 0.0f;
-	vertices[centerTopIndex * 8 + 6] = 0.5f;
-	vertices[centerTopIndex * 8 + 7] = 1.0f;
-
-	// Set indices
-	int index = 0;
-	for (int i = 0; i < numSegments; ++i) {
-		indices[index++] = i;
-		indices[index++] = i + numSegments + 1;
-		indices[index++] = i + numSegments + 2;
-
-		indices[index++] = i;
-		indices[index++] = i + numSegments + 2;
-		indices[index++] = i + 1;
-
-		// Indices for bottom face
-		indices[index++] = centerBottomIndex;
-		indices[index++] = i;
-		indices[index++] = i + 1;
-
-		// Indices for top face
-		indices[index++] = centerTopIndex;
-		indices[index++] = i + numSegments + 2;
-		indices[index++] = i + numSegments + 1;
-	}
+// cuts a processed mesh into meshlets and adds it to the pool, packed when PACKED_VERTICES is set
+void UAddMesh(MeshPool& pool, GLMesh& mesh, const VertexLayout& layout, IndexedMesh processed)
+{
+	PreparedLevel prepared = prepareLevel(std::move(processed), layout, PACKED_VERTICES, 0.0f);
+	mesh.meshlets = prepared.meshlets;
+	mesh.geometry = uploadLevel(pool, prepared);
+}
 
-	glGenVertexArrays(1, &mesh.vao);
-	glGenBuffers(1, &mesh.vbo);
-	glGenBuffers(1, &mesh.ebo);
+// adds a mesh the compiler generated; only welding, cache ordering and packing run at startup
+template <typename Baked>
+void UAddBakedMesh(MeshPool& pool, GLMesh& mesh, const Baked& baked)
+{
+	UAddMesh(pool, mesh, PROCEDURAL_LAYOUT, UWithTangents(processMesh(baked.vertices.data(), baked.vertexCount, GENERATOR_FLOATS_PER_VERTEX, baked.indices.data(), baked.indexCount)));
+	mesh.nIndices = baked.indexCount;
+}
 
-	glBindVertexArray(mesh.vao);
+// one chain level per LOD_SEGMENTS entry, finest first
+template <size_t... Levels>
+void UCreateLodChains(MeshPool& pool, LodChain& cups, LodChain& handles, LodChain& pens, std::index_sequence<Levels...>)
+{
+	(UCreateLodLevel<Levels>(pool, cups, handles, pens), ...);
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBufferData(GL_ARRAY_BUFFER, numVertices * 8 * sizeof(float), vertices, GL_STATIC_DRAW);
+// the cup, handle and pen at LOD_SEGMENTS[Level], tagged with how far the polygon strays from the true circle
+template <size_t Level>
+void UCreateLodLevel(MeshPool& pool, LodChain& cups, LodChain& handles, LodChain& pens)
+{
+	constexpr int segments = LOD_SEGMENTS[Level];
+	constexpr int tubeSegments = lodTubeSegments(segments);
+	GLMesh cup, handle, pen;
+	if (BAKED_LOD_GEOMETRY)
+	{
+		UAddBakedMesh(pool, cup, BakedLodLevel<segments>::cup);
+		UAddBakedMesh(pool, handle, BakedLodLevel<segments>::handle);
+		UAddBakedMesh(pool, pen, BakedLodLevel<segments>::pen);
+	}
+	else
+	{
+		UCreateCupMesh(pool, cup, segments);
+		UCreateHandleMesh(pool, handle, segments, tubeSegments);
+		UCreatePenMesh(pool, pen, segments);
+	}
+	cups.addLevel(cup.geometry, cup.nIndices, circleLodError(CUP_TOP_RADIUS, segments), cup.meshlets);
+	handles.addLevel(handle.geometry, handle.nIndices, std::max(circleLodError(HANDLE_RING_RADIUS + HANDLE_TUBE_RADIUS, segments), circleLodError(HANDLE_TUBE_RADIUS, tubeSegments)), handle.meshlets);
+	pens.addLevel(pen.geometry, pen.nIndices, circleLodError(PEN_RADIUS, segments), pen.meshlets);
+}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+void UCreateCupMesh(MeshPool& pool, GLMesh& mesh, int numSegments) {
+	// generated into the shared scratch memory, then into the shared mesh pool
+	IndexedMesh processed = UGenerateCupMesh(generatorArena, CUP_BOTTOM_RADIUS, CUP_TOP_RADIUS, CUP_HEIGHT, numSegments);
+	mesh.nIndices = (GLsizei)processed.indices.size();
+	UAddMesh(pool, mesh, PROCEDURAL_LAYOUT, std::move(processed));
+}
 
-	// Set vertex attribute pointers
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
+// the CPU half of the cup: generated into the arena and processed, nothing uploaded
+IndexedMesh UGenerateCupMesh(MeshArena& arena, float bottomRadius, float topRadius, float height, int numSegments)
+{
+	FrustumShape cup;
+	cup.bottomRadius = bottomRadius;
+	cup.topRadius = topRadius;
+	cup.height = height;
+	cup.segments = numSegments;
+
+	MeshCounts counts = frustumCounts(cup);
+	MeshOutput output = arena.allocate(counts);
+	generateFrustum(cup, output);
+	return UWithTangents(processMesh(output.vertices, counts.vertices, GENERATOR_FLOATS_PER_VERTEX, output.indices, counts.indices));
+}
 
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
 
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
 
-	glBindVertexArray(0);
 
-	mesh.nIndices = numIndices;
 
-	delete[] vertices;
-	delete[] indices;
+void UCreateHandleMesh(MeshPool& pool, GLMesh& mesh, int torusSegments, int tubeSegments)
+{
+	// generated into the shared scratch memory, then into the shared mesh pool
+	IndexedMesh processed = UGenerateHandleMesh(generatorArena, HANDLE_RING_RADIUS, HANDLE_TUBE_RADIUS, torusSegments, tubeSegments);
+	mesh.nIndices = (GLsizei)processed.indices.size();
+	UAddMesh(pool, mesh, PROCEDURAL_LAYOUT, std::move(processed));
 }
 
+// the CPU half of the handle: generated into the arena and processed, nothing uploaded
+IndexedMesh UGenerateHandleMesh(MeshArena& arena, float ringRadius, float tubeRadius, int torusSegments, int tubeSegments)
+{
+	TorusShape handle;
+	handle.ringRadius = ringRadius;
+	handle.tubeRadius = tubeRadius;
+	handle.ringSegments = torusSegments;
+	handle.tubeSegments = tubeSegments;
+
+	MeshCounts counts = torusCounts(handle);
+	MeshOutput output = arena.allocate(counts);
+	generateTorus(handle, output);
+	return UWithTangents(processMesh(output.vertices, counts.vertices, GENERATOR_FLOATS_PER_VERTEX, output.indices, counts.indices));
+}
 
+// widens a processed procedural mesh by a tangent and bitangent per vertex when PROCEDURAL_TANGENTS is set
+IndexedMesh UWithTangents(IndexedMesh processed)
+{
+	if (!PROCEDURAL_TANGENTS)
+		return processed;
+	IndexedMesh widened = appendTangentSlots(processed);
+	generateTangents(widened);
+	return widened;
+}
 
+// the segments of a live shape at a LOD level, scaled down the way LOD_SEGMENTS steps
+int ULodSegments(int segments, size_t level, int minimum)
+{
+	return std::max(minimum, (int)((long long)segments * LOD_SEGMENTS[level] / LOD_SEGMENTS[0]));
+}
 
-
-void UCreateHandleMesh(GLMesh& mesh)
+// the cup's chain for the given dimensions; runs on the cup's rebuild worker, in scratch memory of its own
+PreparedChain UPrepareCupChain(const ShapeParameters& shape)
 {
-	float torusRadius = 0.4f;
-	float tubeRadius = 0.05f;
-	int torusSegments = 50;
-	int tubeSegments = 20;
-
-	// Calculate the number of vertices and indices required
-	int numVertices = torusSegments * tubeSegments;
-	int numIndices = numVertices * 6;
-
-	// Create arrays to hold the vertex, normal, texture coordinate, and index data
-	float* vertices = new float[numVertices * 8]; // 3 for position, 3 for normal, 2 for texture coordinates
-	unsigned int* indices = new unsigned int[numIndices];
-
-	// Generate the vertex and index data
-	float torusAngleStep = 2.0f * glm::pi<float>() / torusSegments;
-	float tubeAngleStep = 2.0f * glm::pi<float>() / tubeSegments;
-	int vertexIndex = 0;
-	int indexIndex = 0;
-
-	for (int i = 0; i < torusSegments; ++i)
+	MeshArena arena;
+	PreparedChain chain;
+	float radius = std::max(shape.cupBottomRadius, shape.cupTopRadius);
+	for (size_t level = 0; level < std::size(LOD_SEGMENTS); level++)
 	{
-		float torusAngle = i * torusAngleStep;
-
-		for (int j = 0; j < tubeSegments; ++j)
-		{
-			float tubeAngle = j * tubeAngleStep;
-
-			// Calculate the position of the vertex
-			float x = (torusRadius + tubeRadius * cos(tubeAngle)) * cos(torusAngle);
-			float y = tubeRadius * sin(tubeAngle);
-			float z = (torusRadius + tubeRadius * cos(tubeAngle)) * sin(torusAngle);
-
-			// Calculate the normal direction of the vertex
-			glm::vec3 normal = glm::normalize(glm::vec3(x, y, z));
-
-			// Calculate texture coordinates based on i and j
-			float s = static_cast<float>(i) / static_cast<float>(torusSegments);
-			float t = static_cast<float>(j) / static_cast<float>(tubeSegments);
-
-			// Store the vertex position, normal, and texture coordinates
-			vertices[vertexIndex] = x;
-			vertices[vertexIndex + 1] = y;
-			vertices[vertexIndex + 2] = z;
-			vertices[vertexIndex + 3] = normal.x;
-			vertices[vertexIndex + 4] = normal.y;
-			vertices[vertexIndex + 5] = normal.z;
-			vertices[vertexIndex + 6] = s;
-			vertices[vertexIndex + 7] = t;
-
-			vertexIndex += 8;
-
-			// Calculate the indices of the surrounding vertices
-			int nextTube = (j + 1) % tubeSegments;
-			int nextTorus = (i + 1) % torusSegments;
-
-			int topLeft = i * tubeSegments + j;
-			int topRight = i * tubeSegments + nextTube;
-			int bottomLeft = nextTorus * tubeSegments + j;
-			int bottomRight = nextTorus * tubeSegments + nextTube;
-
-			// Create two triangles for each quad
-			indices[indexIndex++] = topLeft;
-			indices[indexIndex++] = topRight;
-			indices[indexIndex++] = bottomLeft;
-
-			indices[indexIndex++] = bottomLeft;
-			indices[indexIndex++] = topRight;
-			indices[indexIndex++] = bottomRight;
-		}
+		int segments = ULodSegments(shape.cupSegments, level, 3);
+		chain.levels.push_back(prepareLevel(UGenerateCupMesh(arena, shape.cupBottomRadius, shape.cupTopRadius, shape.cupHeight, segments),
+			PROCEDURAL_LAYOUT, PACKED_VERTICES, circleLodError(radius, segments)));
 	}
+	chain.radius = glm::length(glm::vec2(radius, shape.cupHeight * 0.5f));
+	return chain;
+}
 
-	glGenVertexArrays(1, &mesh.vao);
-	glGenBuffers(1, &mesh.vbo);
-	glGenBuffers(1, &mesh.ebo);
-
-	glBindVertexArray(mesh.vao);
-
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBufferData(GL_ARRAY_BUFFER, numVertices * 8 * sizeof(float), vertices, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned int), indices, GL_STATIC_DRAW);
-
-	// Set vertex attribute pointers
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	glBindVertexArray(0);
-
-	mesh.nIndices = numIndices;
+// the handle's chain for the given dimensions; runs on the handle's rebuild worker
+PreparedChain UPrepareHandleChain(const ShapeParameters& shape)
+{
+	MeshArena arena;
+	PreparedChain chain;
+	for (size_t level = 0; level < std::size(LOD_SEGMENTS); level++)
+	{
+		int ringSegments = ULodSegments(shape.handleRingSegments, level, 3);
+		int tubeSegments = ULodSegments(shape.handleTubeSegments, level, 4);
+		float error = std::max(circleLodError(shape.handleRingRadius + shape.handleTubeRadius, ringSegments), circleLodError(shape.handleTubeRadius, tubeSegments));
+		chain.levels.push_back(prepareLevel(UGenerateHandleMesh(arena, shape.handleRingRadius, shape.handleTubeRadius, ringSegments, tubeSegments),
+			PROCEDURAL_LAYOUT, PACKED_VERTICES, error));
+	}
+	chain.radius = shape.handleRingRadius + shape.handleTubeRadius;
+	return chain;
+}
 
-	delete[] vertices;
-	delete[] indices;
+// one shape edit: R/F, T/G and Y/H grow and shrink the cup's radius, height and segments;
+// U/J, I/K and O/L the handle's ring radius, tube radius and segments
+void UEditShape(int key)
+{
+	ShapeParameters& shape = shapeParameters;
+	const float step = 1.1f;
+	switch (key)
+	{
+	case GLFW_KEY_R: shape.cupBottomRadius *= step; shape.cupTopRadius *= step; break;
+	case GLFW_KEY_F: shape.cupBottomRadius /= step; shape.cupTopRadius /= step; break;
+	case GLFW_KEY_T: shape.cupHeight *= step; break;
+	case GLFW_KEY_G: shape.cupHeight /= step; break;
+	case GLFW_KEY_Y: shape.cupSegments = std::min(shape.cupSegments * 2, MAX_LIVE_SEGMENTS); break;
+	case GLFW_KEY_H: shape.cupSegments = std::max(shape.cupSegments / 2, LOD_SEGMENTS[0] / 4); break;
+	case GLFW_KEY_U: shape.handleRingRadius *= step; break;
+	case GLFW_KEY_J: shape.handleRingRadius /= step; break;
+	case GLFW_KEY_I: shape.handleTubeRadius *= step; break;
+	case GLFW_KEY_K: shape.handleTubeRadius /= step; break;
+	case GLFW_KEY_O: shape.handleRingSegments = std::min(shape.handleRingSegments * 2, MAX_LIVE_SEGMENTS); break;
+	case GLFW_KEY_L: shape.handleRingSegments = std::max(shape.handleRingSegments / 2, LOD_SEGMENTS[0] / 4); break;
+	default: return;
+	}
+	shape.handleTubeSegments = std::min(lodTubeSegments(shape.handleRingSegments), MAX_LIVE_TUBE_SEGMENTS);
+	bool cupKey = key == GLFW_KEY_R || key == GLFW_KEY_F || key == GLFW_KEY_T || key == GLFW_KEY_G || key == GLFW_KEY_Y || key == GLFW_KEY_H;
+	(cupKey ? cupShapeChanged : handleShapeChanged) = true;
 }
 
 
 
-void UCreatePlaneMesh(GLMesh& mesh)
+void UCreatePlaneMesh(MeshPool& pool, GLMesh& mesh)
 {
 	// Define the vertices, texture coordinates, and indices for the plane here.
 	float vertices[] = {
@@ -668,36 +812,14 @@ void UCreatePlaneMesh(GLMesh& mesh)
 		0, 2, 3  // Second triangle
 	};
 
-	// Create and bind the vertex array object (VAO)
-	glGenVertexArrays(1, &mesh.vao);
-	glBindVertexArray(mesh.vao);
-
-	// Create and bind the vertex buffer object (VBO)
-	glGenBuffers(1, &mesh.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	// Create and bind the element buffer object (EBO)
-	glGenBuffers(1, &mesh.ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	// Set the vertex attribute pointers for position
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	// Set the vertex attribute pointers for texture coordinates
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	// Unbind the VAO
-	glBindVertexArray(0);
+	// Copy the vertices and indices into the shared mesh pool
+	UAddMesh(pool, mesh, POSITION_UV, processMesh(vertices, sizeof(vertices) / (5 * sizeof(float)), 5, indices, sizeof(indices) / sizeof(indices[0])));
 
 	// Set the number of indices
 	mesh.nIndices = sizeof(indices) / sizeof(indices[0]);
 }
 
-void UCreatePaper1Mesh(GLMesh& mesh)
+void UCreatePaper1Mesh(MeshPool& pool, GLMesh& mesh)
 {
 	// Define the vertices, texture coordinates, normals, and indices for a cube
 	float vertices[] = {
@@ -750,33 +872,14 @@ void UCreatePaper1Mesh(GLMesh& mesh)
 		-1.0f, -0.01f, -1.5f,    0.0f, -1.0f,  0.0f,    0.0f, 1.0f, // Top-left
 	};
 
-	// Create and bind the vertex array object (VAO)
-	glGenVertexArrays(1, &mesh.vao);
-	glBindVertexArray(mesh.vao);
-
-	// Create and bind the vertex buffer object (VBO)
-	glGenBuffers(1, &mesh.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	// Set the vertex attribute pointers for position, normal, and texture coordinates
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	// Unbind the VAO
-	glBindVertexArray(0);
+	// Weld the duplicated corners into an indexed mesh and copy it into the shared mesh pool
+	UAddMesh(pool, mesh, POSITION_NORMAL_UV, processMesh(vertices, sizeof(vertices) / (8 * sizeof(float)), 8));
 
 	// Set the number of indices
 	mesh.nIndices = 36; // 6 sides * 2 triangles per side * 3 vertices per triangle
 }
 
-void UCreatePaper2Mesh(GLMesh& mesh)
+void UCreatePaper2Mesh(MeshPool& pool, GLMesh& mesh)
 {
 	// Define the vertices, texture coordinates, normals, and indices for a paper mesh
 	float vertices[] = {
@@ -830,33 +933,14 @@ void UCreatePaper2Mesh(GLMesh& mesh)
 	};
 
 
-	// Create and bind the vertex array object (VAO)
-	glGenVertexArrays(1, &mesh.vao);
-	glBindVertexArray(mesh.vao);
-
-	// Create and bind the vertex buffer object (VBO)
-	glGenBuffers(1, &mesh.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	// Set the vertex attribute pointers for position, normal, and texture coordinates
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	// Unbind the VAO
-	glBindVertexArray(0);
+	// Weld the duplicated corners into an indexed mesh and copy it into the shared mesh pool
+	UAddMesh(pool, mesh, POSITION_NORMAL_UV, processMesh(vertices, sizeof(vertices) / (8 * sizeof(float)), 8));
 
 	// Set the number of indices
 	mesh.nIndices = 36; // 6 sides * 2 triangles per side * 3 vertices per triangle
 }
 
-void UCreatePaper3Mesh(GLMesh& mesh)
+void UCreatePaper3Mesh(MeshPool& pool, GLMesh& mesh)
 {
 	// Define the vertices, texture coordinates, normals, and indices for a paper mesh
 	float vertices[] = {
@@ -910,142 +994,18 @@ void UCreatePaper3Mesh(GLMesh& mesh)
 	};
 
 
-	// Create and bind the vertex array object (VAO)
-	glGenVertexArrays(1, &mesh.vao);
-	glBindVertexArray(mesh.vao);
-
-	// Create and bind the vertex buffer object (VBO)
-	glGenBuffers(1, &mesh.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	// Set the vertex attribute pointers for position, normal, and texture coordinates
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	// Unbind the VAO
-	glBindVertexArray(0);
+	// Weld the duplicated corners into an indexed mesh and copy it into the shared mesh pool
+	UAddMesh(pool, mesh, POSITION_NORMAL_UV, processMesh(vertices, sizeof(vertices) / (8 * sizeof(float)), 8));
 
 	// Set the number of indices
 	mesh.nIndices = 36; // 6 sides * 2 triangles per side * 3 vertices per triangle
 }
 
-void UCreatePenMesh(GLMesh& mesh) {
-    float baseRadius = 0.05f;
-    float topRadius = 0.05f;
-    float height = 1.0f;
-    int numSegments = 50;
-
-    int numVertices = (numSegments + 1) * 2 + 2;  // Additional vertices for the top and bottom centers
-    int numIndices = numSegments * 6 + numSegments * 3 * 2;  // Additional indices for the top and bottom faces
-
-    float* vertices = new float[numVertices * 8];
-    unsigned int* indices = new unsigned int[numIndices];
-
-    // Generate vertices and indices
-    for (int i = 0; i <= numSegments; ++i) {
-        float angle = 2.0f * glm::pi<float>() * static_cast<float>(i) / static_cast<float>(numSegments);
-        float x = cos(angle);
-        float z = sin(angle);
-
-        // Calculate vertex positions for the bottom base
-        vertices[i * 8] = x * baseRadius;
-        vertices[i * 8 + 1] = -height / 2.0f;
-        vertices[i * 8 + 2] = z * baseRadius;
-        vertices[i * 8 + 3] = x;
-        vertices[i * 8 + 4] = 0.0f;
-        vertices[i * 8 + 5] = z;
-        vertices[i * 8 + 6] = static_cast<float>(i) / static_cast<float>(numSegments);
-        vertices[i * 8 + 7] = 0.0f;
-
-        // Calculate vertex positions for the top base
-        vertices[(i + numSegments + 1) * 8] = x * topRadius;
-        vertices[(i + numSegments + 1) * 8 + 1] = height / 2.0f;
-        vertices[(i + numSegments + 1) * 8 + 2] = z * topRadius;
-        vertices[(i + numSegments + 1) * 8 + 3] = x;
-        vertices[(i + numSegments + 1) * 8 + 4] = 0.0f;
-        vertices[(i + numSegments + 1) * 8 + 5] = z;
-        vertices[(i + numSegments + 1) * 8 + 6] = static_cast<float>(i) / static_cast<float>(numSegments);
-        vertices[(i + numSegments + 1) * 8 + 7] = 1.0f;
-    }
-
-    // Add vertices for the top and bottom centers
-    int centerBottomIndex = numVertices - 2;
-    int centerTopIndex = numVertices - 1;
-    vertices[centerBottomIndex * 8] = 0.0f;
-    vertices[centerBottomIndex * 8 + 1] = -height / 2.0f;
-    vertices[centerBottomIndex * 8 + 2] = 0.0f;
-    vertices[centerBottomIndex * 8 + 3] = 0.0f;
-    vertices[centerBottomIndex * 8 + 4] = -1.0f;
-    vertices[centerBottomIndex * 8 + 5] = 0.0f;
-    vertices[centerBottomIndex * 8 + 6] = 0.5f;
-    vertices[centerBottomIndex * 8 + 7] = 0.0f;
-
-    vertices[centerTopIndex * 8] = 0.0f;
-    vertices[centerTopIndex * 8 + 1] = height / 2.0f;
-    vertices[centerTopIndex * 8 + 2] = 0.0f;
-    vertices[centerTopIndex * 8 + 3] = 0.0f;
-    vertices[centerTopIndex * 8 + 4] = 1.0f;
-    vertices[centerTopIndex * 8 + 5] = 0.0f;
-    vertices[centerTopIndex * 8 + 6] = 0.5f;
-    vertices[centerTopIndex * 8 + 7] = 1.0f;
-
-    // Set indices
-    int index = 0;
-    for (int i = 0; i < numSegments; ++i) {
-        indices[index++] = i;
-        indices[index++] = i + numSegments + 1;
-        indices[index++] = i + numSegments + 2;
-
-        indices[index++] = i;
-        indices[index++] = i + numSegments + 2;
-        indices[index++] = i + 1;
-
-        // Indices for bottom face
-        indices[index++] = centerBottomIndex;
-        indices[index++] = i;
-        indices[index++] = i + 1;
-
-        // Indices for top face
-        indices[index++] = centerTopIndex;
-        indices[index++] = i + numSegments + 2;
-        indices[index++] = i + numSegments + 1;
-    }
-
-    glGenVertexArrays(1, &mesh.vao);
-    glGenBuffers(1, &mesh.vbo);
-    glGenBuffers(1, &mesh.ebo);
-
-    glBindVertexArray(mesh.vao);
-
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-    glBufferData(GL_ARRAY_BUFFER, numVertices * 8 * sizeof(float), vertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned int), indices, GL_STATIC_DRAW);
-
-    // Set vertex attribute pointers
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    glBindVertexArray(0);
-
-    mesh.nIndices = numIndices;
-
-    delete[] vertices;
-    delete[] indices;
+void UCreatePenMesh(MeshPool& pool, GLMesh& mesh, int numSegments) {
+    // a frustum with equal radii, generated like the cup
+    IndexedMesh processed = UGenerateCupMesh(generatorArena, PEN_RADIUS, PEN_RADIUS, PEN_HEIGHT, numSegments);
+    mesh.nIndices = (GLsizei)processed.indices.size();
+    UAddMesh(pool, mesh, PROCEDURAL_LAYOUT, std::move(processed));
 }
 
 
@@ -1083,6 +1043,45 @@ void processInput(GLFWwindow* window)
         birdEyeKeyPressed = false;
     }
 
+	// M prints where the GPU memory is going
+	if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS && !memoryReportKeyPressed) {
+		memoryReportRequested = true;
+		memoryReportKeyPressed = true;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_M) == GLFW_RELEASE) {
+		memoryReportKeyPressed = false;
+	}
+
+	// [ and ] trade detail for triangles across every LOD chain
+	if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS && !lodBiasKeyPressed) {
+		lodSettings.bias -= 1.0f;
+		lodBiasKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS && !lodBiasKeyPressed) {
+		lodSettings.bias += 1.0f;
+		lodBiasKeyPressed = true;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_RELEASE && glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_RELEASE) {
+		lodBiasKeyPressed = false;
+	}
+
+	// the live cup and handle dimensions, one step per press (see UEditShape)
+	const int shapeKeys[] = { GLFW_KEY_R, GLFW_KEY_F, GLFW_KEY_T, GLFW_KEY_G, GLFW_KEY_Y, GLFW_KEY_H,
+		GLFW_KEY_U, GLFW_KEY_J, GLFW_KEY_I, GLFW_KEY_K, GLFW_KEY_O, GLFW_KEY_L };
+	int shapeKey = 0;
+	for (int key : shapeKeys)
+		if (glfwGetKey(window, key) == GLFW_PRESS)
+			shapeKey = key;
+	if (shapeKey != 0 && !shapeKeyPressed) {
+		UEditShape(shapeKey);
+		shapeKeyPressed = true;
+	}
+	if (shapeKey == 0) {
+		shapeKeyPressed = false;
+	}
+
 	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
 		(birdEyeView ? birdEyeCamera : camera).ProcessKeyboard(UP, deltaTime);
 	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
@@ -1133,43 +1132,3 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 	if (cameraSpeed > 10.0f)
 		cameraSpeed = 10.0f;
 }
-
-
-// utility function for loading a 2D texture from file
-// ---------------------------------------------------
-unsigned int loadTexture(char const* path)
-{
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-	}
-
-	return textureID;
-}
@@ -0,0 +1,195 @@
+#ifndef BAKED_MESHES_H
+#define BAKED_MESHES_H
+
+#include "mesh_generators.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Meshes computed by the compiler. bakeFrustum and bakeTorus produce the same vertices and
+// indices as generateFrustum and generateTorus (mesh_generators.h), but as constexpr arrays, so
+// a shape whose parameters are all constants costs no generation at startup and its data sits
+// in the binary's read-only section:
+//
+//   static constexpr auto CUP = bakeFrustum<64>(0.4f, 0.5f, 1.0f);
+//   processMesh(CUP.vertices.data(), CUP.vertexCount, GENERATOR_FLOATS_PER_VERTEX, CUP.indices.data(), CUP.indexCount);
+//
+// Shapes only known at run time keep using the runtime generators.
+
+template <size_t Vertices, size_t Indices>
+struct BakedMesh
+{
+	static constexpr uint32_t vertexCount = (uint32_t)Vertices;
+	static constexpr uint32_t indexCount = (uint32_t)Indices;
+
+	std::array<float, Vertices * GENERATOR_FLOATS_PER_VERTEX> vertices{};
+	std::array<uint32_t, Indices> indices{};
+};
+
+// sine and cosine in double precision for constant expressions; the series run past float precision
+constexpr void bakedSinCos(double angle, double& sine, double& cosine)
+{
+	const double halfPi = 1.57079632679489661923;
+	double scaled = angle / halfPi;
+	long long quadrant = (long long)(scaled + (scaled >= 0.0 ? 0.5 : -0.5));
+	double r = angle - (double)quadrant * halfPi;
+	double z = r * r;
+
+	double s = r, c = 1.0, sineTerm = r, cosineTerm = 1.0;
+	for (int k = 1; k <= 9; k++)
+	{
+		sineTerm *= -z / (double)((2 * k) * (2 * k + 1));
+		cosineTerm *= -z / (double)((2 * k - 1) * (2 * k));
+		s += sineTerm;
+		c += cosineTerm;
+	}
+	switch (quadrant & 3)
+	{
+	case 0: sine = s; cosine = c; break;
+	case 1: sine = c; cosine = -s; break;
+	case 2: sine = -s; cosine = -c; break;
+	default: sine = -c; cosine = s; break;
+	}
+}
+
+// direction i of a full turn in `segments` steps; the last direction is exactly the first
+constexpr void bakedTurn(int i, int segments, double& sine, double& cosine)
+{
+	bakedSinCos(6.28318530717958647692 * (double)(i % segments) / (double)segments, sine, cosine);
+}
+
+// generateLathe at compile time, for profiles without poles. The profile is worked out once and
+// every ring is a rotated copy of it, written straight through pointers: the evaluation budget of
+// the compilers (constexpr steps) goes on the output, not on trigonometry or temporaries.
+constexpr void bakeLathe(const ProfilePoint* profile, uint32_t columns, int segments, float*& vertex, uint32_t*& index)
+{
+	for (int r = 0; r <= segments; r++)
+	{
+		double sine = 0.0, cosine = 0.0;
+		bakedTurn(r, segments, sine, cosine);
+		float s = (float)sine, c = (float)cosine, u = (float)r / (float)segments;
+		for (uint32_t j = 0; j < columns; j++)
+		{
+			const ProfilePoint& point = profile[j];
+			*vertex++ = point.radius * c;
+			*vertex++ = point.y;
+			*vertex++ = point.radius * s;
+			*vertex++ = point.normalRadius * c;
+			*vertex++ = point.normalY;
+			*vertex++ = point.normalRadius * s;
+			*vertex++ = u;
+			*vertex++ = point.v;
+		}
+	}
+	for (uint32_t row = 0; row < (uint32_t)segments * columns; row += columns)
+		for (uint32_t a = row, b = row + columns; a + 1 < row + columns; a++, b++)
+		{
+			*index++ = a;
+			*index++ = a + 1;
+			*index++ = b;
+			*index++ = b;
+			*index++ = a + 1;
+			*index++ = b + 1;
+		}
+}
+
+constexpr size_t bakedFrustumVertices(int segments)
+{
+	return (size_t)(segments + 1) * 2 + (size_t)(segments + 2) * 2;
+}
+
+constexpr size_t bakedFrustumIndices(int segments)
+{
+	return (size_t)segments * 6 + (size_t)segments * 3 * 2;
+}
+
+// generateFrustum with caps, at compile time
+template <int Segments>
+constexpr BakedMesh<bakedFrustumVertices(Segments), bakedFrustumIndices(Segments)> bakeFrustum(float bottomRadius, float topRadius, float height)
+{
+	BakedMesh<bakedFrustumVertices(Segments), bakedFrustumIndices(Segments)> mesh;
+	double slope = (double)bottomRadius - (double)topRadius;
+	double lengthSquared = height * (double)height + slope * slope;
+	// constexpr square root by Newton's method
+	double root = lengthSquared > 1.0 ? lengthSquared : 1.0;
+	for (int step = 0; step < 64; step++)
+		root = 0.5 * (root + lengthSquared / root);
+	float normalRadius = (float)(height / root), normalY = (float)(slope / root);
+
+	// side: a lathe of two profile points, bottom then top
+	const ProfilePoint side[2] = {
+		{ bottomRadius, -height * 0.5f, normalRadius, normalY, 0.0f },
+		{ topRadius, height * 0.5f, normalRadius, normalY, 1.0f },
+	};
+	float* vertex = mesh.vertices.data();
+	uint32_t* index = mesh.indices.data();
+	bakeLathe(side, 2, Segments, vertex, index);
+
+	// caps: a centre and a ring each, bottom facing down, then top facing up
+	uint32_t centre = (uint32_t)(Segments + 1) * 2;
+	for (int cap = 0; cap < 2; cap++, centre += Segments + 2)
+	{
+		float y = cap == 0 ? -height * 0.5f : height * 0.5f;
+		float radius = cap == 0 ? bottomRadius : topRadius;
+		float capNormalY = cap == 0 ? -1.0f : 1.0f;
+		*vertex++ = 0.0f;
+		*vertex++ = y;
+		*vertex++ = 0.0f;
+		*vertex++ = 0.0f;
+		*vertex++ = capNormalY;
+		*vertex++ = 0.0f;
+		*vertex++ = 0.5f;
+		*vertex++ = 0.5f;
+		for (int r = 0; r <= Segments; r++)
+		{
+			double sine = 0.0, cosine = 0.0;
+			bakedTurn(r, Segments, sine, cosine);
+			*vertex++ = (float)(radius * cosine);
+			*vertex++ = y;
+			*vertex++ = (float)(radius * sine);
+			*vertex++ = 0.0f;
+			*vertex++ = capNormalY;
+			*vertex++ = 0.0f;
+			*vertex++ = (float)(0.5 + 0.5 * cosine);
+			*vertex++ = (float)(0.5 + 0.5 * sine);
+		}
+		for (uint32_t ring = centre + 1; ring < centre + 1 + Segments; ring++)
+		{
+			*index++ = centre;
+			*index++ = cap == 0 ? ring : ring + 1;
+			*index++ = cap == 0 ? ring + 1 : ring;
+		}
+	}
+	return mesh;
+}
+
+constexpr size_t bakedTorusVertices(int ringSegments, int tubeSegments)
+{
+	return (size_t)(ringSegments + 1) * (size_t)(tubeSegments + 1);
+}
+
+constexpr size_t bakedTorusIndices(int ringSegments, int tubeSegments)
+{
+	return (size_t)ringSegments * (size_t)tubeSegments * 6;
+}
+
+// generateTorus at compile time: one tube ring, swept around the ring
+template <int RingSegments, int TubeSegments>
+constexpr BakedMesh<bakedTorusVertices(RingSegments, TubeSegments), bakedTorusIndices(RingSegments, TubeSegments)> bakeTorus(float ringRadius, float tubeRadius)
+{
+	BakedMesh<bakedTorusVertices(RingSegments, TubeSegments), bakedTorusIndices(RingSegments, TubeSegments)> mesh;
+	ProfilePoint tube[TubeSegments + 1] = {};
+	for (int j = 0; j <= TubeSegments; j++)
+	{
+		double sine = 0.0, cosine = 0.0;
+		bakedTurn(j, TubeSegments, sine, cosine);
+		float c = (float)cosine, s = (float)sine;
+		tube[j] = { ringRadius + tubeRadius * c, tubeRadius * s, c, s, (float)j / (float)TubeSegments };
+	}
+	float* vertex = mesh.vertices.data();
+	uint32_t* index = mesh.indices.data();
+	bakeLathe(tube, TubeSegments + 1, RingSegments, vertex, index);
+	return mesh;
+}
+#endif
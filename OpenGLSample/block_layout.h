@@ -0,0 +1,132 @@
+#ifndef BLOCK_LAYOUT_H
+#define BLOCK_LAYOUT_H
+
+#include <cstddef>
+
+// Compile-time description of GLSL uniform/storage block layouts.
+//
+// A block (or struct) is described by listing its GLSL member types in declaration order,
+// e.g. glsl::Struct<glsl::Vec3, glsl::Float, glsl::Vec3>. Layout<Std140, T> then computes the
+// base alignment, size and member offsets with the std140 or std430 rules from the GL spec
+// (section 7.6.2.2), entirely in constexpr. The C++ mirror struct is checked against it with
+// CHECK_BLOCK_SIZE / CHECK_BLOCK_MEMBER, so a mirror that would silently corrupt the block
+// (a glm::vec3 followed by a float in the wrong place, a missing pad) fails to compile and
+// correct mirrors can be memcpy'd straight into a mapped buffer.
+
+namespace glsl
+{
+	struct Float {};
+	struct Int {};
+	struct UInt {};
+	struct Vec2 {};
+	struct Vec3 {};
+	struct Vec4 {};
+	struct IVec4 {};
+	struct Mat3 {};
+	struct Mat4 {};
+	template <typename T, std::size_t N> struct Array {};
+	template <typename... Members> struct Struct {};
+}
+
+constexpr std::size_t roundUp(std::size_t value, std::size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// std140: arrays and structs are padded out to vec4 alignment
+struct Std140
+{
+	static constexpr std::size_t arrayAlignment(std::size_t element) { return roundUp(element, 16); }
+	static constexpr std::size_t structAlignment(std::size_t member) { return roundUp(member, 16); }
+};
+
+// std430 (storage blocks): arrays and structs keep their members' alignment
+struct Std430
+{
+	static constexpr std::size_t arrayAlignment(std::size_t element) { return element; }
+	static constexpr std::size_t structAlignment(std::size_t member) { return member; }
+};
+
+template <typename Rules, typename T> struct Layout;
+
+template <typename Rules, std::size_t Alignment, std::size_t Size>
+struct BasicLayout
+{
+	static constexpr std::size_t alignment = Alignment;
+	static constexpr std::size_t size = Size;
+};
+
+template <typename Rules> struct Layout<Rules, glsl::Float> : BasicLayout<Rules, 4, 4> {};
+template <typename Rules> struct Layout<Rules, glsl::Int> : BasicLayout<Rules, 4, 4> {};
+template <typename Rules> struct Layout<Rules, glsl::UInt> : BasicLayout<Rules, 4, 4> {};
+template <typename Rules> struct Layout<Rules, glsl::Vec2> : BasicLayout<Rules, 8, 8> {};
+template <typename Rules> struct Layout<Rules, glsl::Vec3> : BasicLayout<Rules, 16, 12> {};
+template <typename Rules> struct Layout<Rules, glsl::Vec4> : BasicLayout<Rules, 16, 16> {};
+template <typename Rules> struct Layout<Rules, glsl::IVec4> : BasicLayout<Rules, 16, 16> {};
+
+// arrays: every element starts on a stride that is a multiple of the (rule-adjusted) alignment
+template <typename Rules, typename T, std::size_t N>
+struct Layout<Rules, glsl::Array<T, N>>
+{
+	static constexpr std::size_t alignment = Rules::arrayAlignment(Layout<Rules, T>::alignment);
+	static constexpr std::size_t stride = roundUp(Layout<Rules, T>::size, alignment);
+	static constexpr std::size_t size = stride * N;
+};
+
+// column-major matrices are laid out as arrays of column vectors
+template <typename Rules> struct Layout<Rules, glsl::Mat3> : Layout<Rules, glsl::Array<glsl::Vec3, 3>> {};
+template <typename Rules> struct Layout<Rules, glsl::Mat4> : Layout<Rules, glsl::Array<glsl::Vec4, 4>> {};
+
+// byte offset of the member at the given declaration index in a struct of Members
+template <typename Rules, typename... Members>
+constexpr std::size_t structMemberOffset(std::size_t index)
+{
+	const std::size_t alignments[] = { Layout<Rules, Members>::alignment... };
+	const std::size_t sizes[] = { Layout<Rules, Members>::size... };
+	std::size_t position = 0;
+	for (std::size_t i = 0; i < index; i++)
+		position = roundUp(position, alignments[i]) + sizes[i];
+	return roundUp(position, alignments[index]);
+}
+
+template <typename Rules, typename... Members>
+constexpr std::size_t structMaxAlignment()
+{
+	const std::size_t alignments[] = { Layout<Rules, Members>::alignment... };
+	std::size_t largest = 1;
+	for (std::size_t alignment : alignments)
+		if (alignment > largest)
+			largest = alignment;
+	return largest;
+}
+
+template <typename Rules, typename... Members>
+constexpr std::size_t structEnd()
+{
+	const std::size_t sizes[] = { Layout<Rules, Members>::size... };
+	return structMemberOffset<Rules, Members...>(sizeof...(Members) - 1) + sizes[sizeof...(Members) - 1];
+}
+
+template <typename Rules, typename... Members>
+struct Layout<Rules, glsl::Struct<Members...>>
+{
+	static_assert(sizeof...(Members) > 0, "GLSL structs need at least one member");
+
+	static constexpr std::size_t count = sizeof...(Members);
+	static constexpr std::size_t alignment = Rules::structAlignment(structMaxAlignment<Rules, Members...>());
+	static constexpr std::size_t size = roundUp(structEnd<Rules, Members...>(), alignment);
+
+	static constexpr std::size_t offset(std::size_t index)
+	{
+		return structMemberOffset<Rules, Members...>(index);
+	}
+};
+
+// the C++ mirror occupies exactly as many bytes as the GLSL block
+#define CHECK_BLOCK_SIZE(Type, Rules, GLSLType) \
+	static_assert(sizeof(Type) == Layout<Rules, GLSLType>::size, #Type " size does not match its GLSL layout")
+
+// the C++ member sits at the offset GLSL gives the member at declaration index Index
+#define CHECK_BLOCK_MEMBER(Type, Rules, GLSLType, Index, Member) \
+	static_assert(offsetof(Type, Member) == Layout<Rules, GLSLType>::offset(Index), #Type "::" #Member " does not match its GLSL offset")
+#endif
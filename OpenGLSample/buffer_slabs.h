@@ -0,0 +1,297 @@
+#ifndef BUFFER_SLABS_H
+#define BUFFER_SLABS_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "range_allocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A handle to a range carved out of a SlabAllocator; stays valid while the range moves.
+struct SlabRange
+{
+	uint32_t index = 0;
+	uint32_t generation = 0; // 0 never names a live range
+};
+
+struct SlabStats
+{
+	uint32_t slabs = 0;
+	RangeAllocatorStats ranges; // summed over all slabs; largestFree is the largest in any one slab
+
+	float fragmentation() const
+	{
+		return ranges.fragmentation();
+	}
+};
+
+// Sub-allocates many small vertex or index ranges out of a few large GL buffers ("slabs"), so
+// geometry shares buffers and VAOs instead of owning one buffer object each. Every slab has its
+// own RangeAllocator for the bookkeeping. Ranges are referred to through SlabRange handles and
+// their current offset is looked up at draw time, which lets defragment() compact a slab during
+// an idle frame by copying ranges down on the GPU and rebuilding the slab's allocator.
+class SlabAllocator
+{
+public:
+	// category is what the slabs are accounted under; ranges larger than slabSize get a slab of their own
+	SlabAllocator(MemoryCategory category, uint32_t slabSize, const std::string& label)
+		: category(category), slabSize(slabSize), label(label), scratchSize(0), compactingSlab(NO_SLAB)
+	{
+	}
+
+	SlabAllocator(const SlabAllocator&) = delete;
+	SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+	// carves size bytes aligned to alignment (a byte count, e.g. the vertex stride) and uploads data if given
+	SlabRange allocate(uint32_t size, uint32_t alignment, const void* data = nullptr)
+	{
+		Range range;
+		range.alignment = alignment ? alignment : 1;
+		bool placed = false;
+		for (uint32_t i = 0; i < slabs.size() && !placed; i++)
+		{
+			if (slabs[i].allocator.allocate(size, range.alignment, range.allocation))
+			{
+				range.slab = i;
+				placed = true;
+			}
+		}
+		if (!placed)
+		{
+			range.slab = addSlab(std::max(slabSize, size));
+			if (!slabs[range.slab].allocator.allocate(size, range.alignment, range.allocation))
+			{
+				std::cout << "ERROR::SLAB_ALLOCATOR::OUT_OF_MEMORY requested " << size << " bytes" << std::endl;
+				return SlabRange();
+			}
+		}
+
+		uint32_t index;
+		if (!freeRanges.empty())
+		{
+			index = freeRanges.back();
+			freeRanges.pop_back();
+			range.generation = ranges[index].generation;
+		}
+		else
+		{
+			index = (uint32_t)ranges.size();
+			ranges.push_back(Range());
+		}
+		range.live = true;
+		ranges[index] = range;
+
+		SlabRange handle;
+		handle.index = index;
+		handle.generation = range.generation;
+		if (data)
+			upload(handle, 0, size, data);
+		return handle;
+	}
+
+	// writes size bytes at offset within the range
+	void upload(SlabRange handle, uint32_t offset, uint32_t size, const void* data)
+	{
+		if (!valid(handle))
+			return;
+		const Range& range = ranges[handle.index];
+		glState().bindBuffer(GL_COPY_WRITE_BUFFER, slabs[range.slab].name);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, range.allocation.offset + offset, size, data);
+		glState().bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	void free(SlabRange handle)
+	{
+		if (!valid(handle))
+			return;
+		Range& range = ranges[handle.index];
+		slabs[range.slab].allocator.free(range.allocation);
+		range.live = false;
+		range.generation++;
+		if (range.generation == 0)
+			range.generation = 1;
+		freeRanges.push_back(handle.index);
+	}
+
+	bool valid(SlabRange handle) const
+	{
+		return handle.generation != 0 && handle.index < ranges.size()
+			&& ranges[handle.index].live && ranges[handle.index].generation == handle.generation;
+	}
+
+	// which slab the range lives in; ranges never move between slabs
+	uint32_t slab(SlabRange handle) const
+	{
+		return ranges[handle.index].slab;
+	}
+
+	// current byte offset of the range inside its slab; may change after defragment()
+	uint32_t offset(SlabRange handle) const
+	{
+		return ranges[handle.index].allocation.offset;
+	}
+
+	uint32_t size(SlabRange handle) const
+	{
+		return ranges[handle.index].allocation.size;
+	}
+
+	GLuint slabBuffer(uint32_t slab) const
+	{
+		return slabs[slab].name;
+	}
+
+	uint32_t slabCount() const
+	{
+		return (uint32_t)slabs.size();
+	}
+
+	// Compacts the most fragmented slab a step at a time, moving at most maxBytes per call; meant
+	// for frames with time to spare. Ranges are pushed down against the previous one in offset
+	// order, so each call picks up where the last one stopped, and the same slab is finished
+	// before another one is started. A range larger than maxBytes is moved alone, by a call of
+	// its own. Copies are ordered with the draws around them, so nothing needs to wait. Returns
+	// true if anything moved.
+	bool defragment(uint32_t maxBytes, float minFragmentation = 0.25f)
+	{
+		if (compactingSlab == NO_SLAB)
+		{
+			float bestFragmentation = minFragmentation;
+			for (uint32_t i = 0; i < slabs.size(); i++)
+			{
+				RangeAllocatorStats slabStats = slabs[i].allocator.stats();
+				if (slabStats.freeRanges > 1 && slabStats.fragmentation() >= bestFragmentation)
+				{
+					compactingSlab = i;
+					bestFragmentation = slabStats.fragmentation();
+				}
+			}
+			if (compactingSlab == NO_SLAB)
+				return false;
+		}
+
+		std::vector<uint32_t> order;
+		for (uint32_t i = 0; i < ranges.size(); i++)
+			if (ranges[i].live && ranges[i].slab == compactingSlab)
+				order.push_back(i);
+		std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+		{
+			return ranges[a].allocation.offset < ranges[b].allocation.offset;
+		});
+
+		// everything below the cursor is compacted, so the gap up to the next range is free and
+		// freeing that range leaves room for it at its target
+		Slab& slab = slabs[compactingSlab];
+		uint32_t cursor = 0;
+		uint32_t moved = 0;
+		for (uint32_t index : order)
+		{
+			Range& range = ranges[index];
+			uint32_t from = range.allocation.offset;
+			uint32_t size = range.allocation.size;
+			uint32_t target = (cursor + range.alignment - 1) / range.alignment * range.alignment;
+			if (target != from)
+			{
+				if (moved > 0 && moved + size > maxBytes)
+					return true;
+				// a range overlapping its own destination goes through the scratch buffer
+				if (target + size <= from)
+					copy(slab.name, from, slab.name, target, size);
+				else
+				{
+					GLuint staging = scratchBuffer(size);
+					copy(slab.name, from, staging, 0, size);
+					copy(staging, 0, slab.name, target, size);
+				}
+				slab.allocator.free(range.allocation);
+				slab.allocator.allocateAt(target, size, range.allocation);
+				moved += size;
+			}
+			cursor = target + size;
+		}
+		compactingSlab = NO_SLAB;
+		return moved > 0;
+	}
+
+	SlabStats stats() const
+	{
+		SlabStats result;
+		result.slabs = (uint32_t)slabs.size();
+		for (const Slab& slab : slabs)
+		{
+			RangeAllocatorStats slabStats = slab.allocator.stats();
+			result.ranges.capacity += slabStats.capacity;
+			result.ranges.usedBytes += slabStats.usedBytes;
+			result.ranges.freeBytes += slabStats.freeBytes;
+			result.ranges.freeRanges += slabStats.freeRanges;
+			result.ranges.allocations += slabStats.allocations;
+			result.ranges.largestFree = std::max(result.ranges.largestFree, slabStats.largestFree);
+		}
+		return result;
+	}
+
+private:
+	static const uint32_t NO_SLAB = 0xFFFFFFFFu;
+
+	struct Slab
+	{
+		GpuResource buffer;
+		GLuint name = 0;
+		RangeAllocator allocator;
+	};
+
+	struct Range
+	{
+		uint32_t slab = 0;
+		RangeAllocation allocation;
+		uint32_t alignment = 1;
+		uint32_t generation = 1;
+		bool live = false;
+	};
+
+	MemoryCategory category;
+	uint32_t slabSize;
+	std::string label;
+	std::vector<Slab> slabs;
+	std::vector<Range> ranges;
+	std::vector<uint32_t> freeRanges;
+	GpuResource scratch;
+	uint32_t scratchSize;
+	uint32_t compactingSlab;    // the slab defragment() is part-way through, if any
+
+	uint32_t addSlab(uint32_t size)
+	{
+		Slab slab;
+		slab.buffer = makeBuffer(category, size, NULL, GL_DYNAMIC_STORAGE_BIT, label + " slab " + std::to_string(slabs.size()));
+		slab.name = slab.buffer.id();
+		slab.allocator = RangeAllocator(size);
+		slabs.push_back(std::move(slab));
+		return (uint32_t)slabs.size() - 1;
+	}
+
+	GLuint scratchBuffer(uint32_t size)
+	{
+		if (size > scratchSize)
+		{
+			scratch = makeBuffer(category, size, NULL, 0, label + " compaction scratch");
+			scratchSize = size;
+		}
+		return scratch.id();
+	}
+
+	static void copy(GLuint source, uint32_t sourceOffset, GLuint destination, uint32_t destinationOffset, uint32_t size)
+	{
+		glState().bindBuffer(GL_COPY_READ_BUFFER, source);
+		glState().bindBuffer(GL_COPY_WRITE_BUFFER, destination);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, destinationOffset, size);
+		glState().bindBuffer(GL_COPY_READ_BUFFER, 0);
+		glState().bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+};
+#endif
@@ -0,0 +1,88 @@
+#ifndef DIRTY_RANGES_H
+#define DIRTY_RANGES_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// What changed in a CPU copy since it was last uploaded, as sorted, disjoint [begin, end) ranges
+// in whatever unit the owner counts (records, vertices, indices). Marking merges the new range
+// with every range it overlaps or touches, and with any closer than mergeGap units, since
+// re-sending a few clean units between two edits is cheaper than another upload call. Uploads
+// then cost one call per range and only the bytes that were edited.
+class DirtyRanges
+{
+public:
+	struct Range
+	{
+		size_t begin;
+		size_t end;
+	};
+
+	explicit DirtyRanges(size_t mergeGap = 0)
+		: mergeGap(mergeGap)
+	{
+	}
+
+	void mark(size_t begin, size_t count)
+	{
+		if (count == 0)
+			return;
+		size_t end = begin + count;
+		// the first range that reaches begin, gap included
+		std::vector<Range>::iterator first = std::lower_bound(ranges.begin(), ranges.end(), begin,
+			[this](const Range& range, size_t value) { return range.end + mergeGap < value; });
+		std::vector<Range>::iterator last = first;
+		while (last != ranges.end() && last->begin <= end + mergeGap)
+		{
+			begin = std::min(begin, last->begin);
+			end = std::max(end, last->end);
+			++last;
+		}
+		if (first == last)
+			ranges.insert(first, Range{ begin, end });
+		else
+		{
+			*first = Range{ begin, end };
+			ranges.erase(first + 1, last);
+		}
+	}
+
+	bool empty() const
+	{
+		return ranges.empty();
+	}
+
+	// units covered, gaps merged in included
+	size_t size() const
+	{
+		size_t total = 0;
+		for (const Range& range : ranges)
+			total += range.end - range.begin;
+		return total;
+	}
+
+	const std::vector<Range>& list() const
+	{
+		return ranges;
+	}
+
+	void clear()
+	{
+		ranges.clear();
+	}
+
+	// calls upload(first, count) once per range, in order, then forgets them
+	template <typename Upload>
+	void flush(Upload upload)
+	{
+		for (const Range& range : ranges)
+			upload(range.begin, range.end - range.begin);
+		ranges.clear();
+	}
+
+private:
+	size_t mergeGap;
+	std::vector<Range> ranges;
+};
+#endif
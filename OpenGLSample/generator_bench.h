@@ -0,0 +1,189 @@
+#ifndef GENERATOR_BENCH_H
+#define GENERATOR_BENCH_H
+
+#include "mesh_generators.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+
+// Vertices generated per second by the generator library against the per-vertex loops it
+// replaced in Source.cpp (new[] per mesh, scalar cos/sin per vertex). Run with --bench.
+
+// results are read back through here so the compiler cannot drop the generation
+inline volatile float& generatorSink()
+{
+	static volatile float sink = 0.0f;
+	return sink;
+}
+
+// the original cup/pen loop: a capped frustum whose caps share the side's rings
+inline uint32_t legacyFrustum(float baseRadius, float topRadius, float height, int numSegments)
+{
+	int numVertices = (numSegments + 1) * 2 + 2;
+	int numIndices = numSegments * 6 + numSegments * 3 * 2;
+	float* vertices = new float[numVertices * 8];
+	unsigned int* indices = new unsigned int[numIndices];
+
+	for (int i = 0; i <= numSegments; ++i) {
+		float angle = 2.0f * 3.14159265f * static_cast<float>(i) / static_cast<float>(numSegments);
+		float x = cos(angle);
+		float z = sin(angle);
+		float* bottom = &vertices[i * 8];
+		float* top = &vertices[(i + numSegments + 1) * 8];
+		bottom[0] = x * baseRadius; bottom[1] = -height / 2.0f; bottom[2] = z * baseRadius;
+		bottom[3] = x; bottom[4] = 0.0f; bottom[5] = z;
+		bottom[6] = static_cast<float>(i) / static_cast<float>(numSegments); bottom[7] = 0.0f;
+		top[0] = x * topRadius; top[1] = height / 2.0f; top[2] = z * topRadius;
+		top[3] = x; top[4] = 0.0f; top[5] = z;
+		top[6] = static_cast<float>(i) / static_cast<float>(numSegments); top[7] = 1.0f;
+	}
+	int centerBottomIndex = numVertices - 2;
+	int centerTopIndex = numVertices - 1;
+	const float centers[16] = { 0.0f, -height / 2.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.5f, 0.0f,
+		0.0f, height / 2.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.5f, 1.0f };
+	std::copy(centers, centers + 16, &vertices[centerBottomIndex * 8]);
+
+	int index = 0;
+	for (int i = 0; i < numSegments; ++i) {
+		indices[index++] = i;
+		indices[index++] = i + numSegments + 1;
+		indices[index++] = i + numSegments + 2;
+		indices[index++] = i;
+		indices[index++] = i + numSegments + 2;
+		indices[index++] = i + 1;
+		indices[index++] = centerBottomIndex;
+		indices[index++] = i;
+		indices[index++] = i + 1;
+		indices[index++] = centerTopIndex;
+		indices[index++] = i + numSegments + 2;
+		indices[index++] = i + numSegments + 1;
+	}
+
+	generatorSink() = generatorSink() + vertices[numVertices * 4] + (float)indices[numIndices / 2];
+	delete[] vertices;
+	delete[] indices;
+	return (uint32_t)numVertices;
+}
+
+// the original handle loop
+inline uint32_t legacyTorus(float torusRadius, float tubeRadius, int torusSegments, int tubeSegments)
+{
+	int numVertices = torusSegments * tubeSegments;
+	int numIndices = numVertices * 6;
+	float* vertices = new float[numVertices * 8];
+	unsigned int* indices = new unsigned int[numIndices];
+
+	float torusAngleStep = 2.0f * 3.14159265f / torusSegments;
+	float tubeAngleStep = 2.0f * 3.14159265f / tubeSegments;
+	int vertexIndex = 0;
+	int indexIndex = 0;
+	for (int i = 0; i < torusSegments; ++i)
+	{
+		float torusAngle = i * torusAngleStep;
+		for (int j = 0; j < tubeSegments; ++j)
+		{
+			float tubeAngle = j * tubeAngleStep;
+			float x = (torusRadius + tubeRadius * cos(tubeAngle)) * cos(torusAngle);
+			float y = tubeRadius * sin(tubeAngle);
+			float z = (torusRadius + tubeRadius * cos(tubeAngle)) * sin(torusAngle);
+			float length = std::sqrt(x * x + y * y + z * z);
+			vertices[vertexIndex] = x;
+			vertices[vertexIndex + 1] = y;
+			vertices[vertexIndex + 2] = z;
+			vertices[vertexIndex + 3] = x / length;
+			vertices[vertexIndex + 4] = y / length;
+			vertices[vertexIndex + 5] = z / length;
+			vertices[vertexIndex + 6] = static_cast<float>(i) / static_cast<float>(torusSegments);
+			vertices[vertexIndex + 7] = static_cast<float>(j) / static_cast<float>(tubeSegments);
+			vertexIndex += 8;
+
+			int nextTube = (j + 1) % tubeSegments;
+			int nextTorus = (i + 1) % torusSegments;
+			int topLeft = i * tubeSegments + j;
+			int topRight = i * tubeSegments + nextTube;
+			int bottomLeft = nextTorus * tubeSegments + j;
+			int bottomRight = nextTorus * tubeSegments + nextTube;
+			indices[indexIndex++] = topLeft;
+			indices[indexIndex++] = topRight;
+			indices[indexIndex++] = bottomLeft;
+			indices[indexIndex++] = bottomLeft;
+			indices[indexIndex++] = topRight;
+			indices[indexIndex++] = bottomRight;
+		}
+	}
+
+	generatorSink() = generatorSink() + vertices[numVertices * 4] + (float)indices[numIndices / 2];
+	delete[] vertices;
+	delete[] indices;
+	return (uint32_t)numVertices;
+}
+
+// millions of vertices a second from repeating generate() (which returns its vertex count) for about a quarter second
+template <typename Generate>
+inline double generatorRate(Generate generate)
+{
+	using Clock = std::chrono::steady_clock;
+	uint64_t vertices = 0;
+	Clock::time_point start = Clock::now();
+	double seconds = 0.0;
+	do
+	{
+		vertices += generate();
+		seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	} while (seconds < 0.25);
+	return (double)vertices / seconds * 1e-6;
+}
+
+inline void runGeneratorBenchmark(std::ostream& out)
+{
+	MeshArena arena;
+	out << "GENERATOR::BENCHMARK (million vertices/s, legacy loop vs library)" << std::endl;
+	out << std::fixed << std::setprecision(1);
+
+	const int frustumSegments[] = { 64, 4096, 262144 };
+	for (int segments : frustumSegments)
+	{
+		FrustumShape cup;
+		cup.bottomRadius = 0.4f;
+		cup.topRadius = 0.5f;
+		cup.segments = segments;
+		double legacy = generatorRate([&]() { return legacyFrustum(0.4f, 0.5f, 1.0f, segments); });
+		double library = generatorRate([&]()
+		{
+			MeshCounts counts = frustumCounts(cup);
+			MeshOutput output = arena.allocate(counts);
+			generateFrustum(cup, output);
+			generatorSink() = generatorSink() + output.vertices[counts.vertices * 4] + (float)output.indices[counts.indices / 2];
+			return counts.vertices;
+		});
+		out << "  frustum " << std::setw(7) << segments << " segments: " << std::setw(8) << legacy << " -> " << std::setw(8) << library
+			<< "  (x" << library / legacy << ")" << std::endl;
+	}
+
+	const int torusSegments[][2] = { { 64, 21 }, { 512, 128 }, { 2048, 512 } };
+	for (const int* segments : torusSegments)
+	{
+		TorusShape handle;
+		handle.ringRadius = 0.4f;
+		handle.tubeRadius = 0.05f;
+		handle.ringSegments = segments[0];
+		handle.tubeSegments = segments[1];
+		double legacy = generatorRate([&]() { return legacyTorus(0.4f, 0.05f, segments[0], segments[1]); });
+		double library = generatorRate([&]()
+		{
+			MeshCounts counts = torusCounts(handle);
+			MeshOutput output = arena.allocate(counts);
+			generateTorus(handle, output);
+			generatorSink() = generatorSink() + output.vertices[counts.vertices * 4] + (float)output.indices[counts.indices / 2];
+			return counts.vertices;
+		});
+		out << "  torus " << std::setw(5) << segments[0] << " x " << std::setw(4) << segments[1] << ":       " << std::setw(8) << legacy << " -> " << std::setw(8) << library
+			<< "  (x" << library / legacy << ")" << std::endl;
+	}
+	out << std::defaultfloat;
+}
+#endif
@@ -0,0 +1,175 @@
+#ifndef GEOMETRY_REGISTRY_H
+#define GEOMETRY_REGISTRY_H
+
+#include "buffer_slabs.h"
+
+#include <cstdint>
+#include <unordered_map>
+
+// 64-bit FNV-1a over a byte payload
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// seed of the second hash, which confirms a match of the first
+const uint64_t GEOMETRY_CHECK_SEED = 0x9E3779B97F4A7C15ull;
+
+// A payload's identity for GeometryRegistry. Hashing touches every byte, so a mesh prepared off
+// the GL thread computes it there and hands it to acquire() with the bytes.
+struct GeometryKey
+{
+	uint64_t key = 0;
+	uint64_t check = 0;
+};
+
+inline GeometryKey geometryKeyOf(const void* data, uint32_t size, uint32_t alignment)
+{
+	GeometryKey key;
+	key.key = hashBytes(data, size) ^ ((uint64_t)size << 32) ^ alignment;
+	key.check = hashBytes(data, size, GEOMETRY_CHECK_SEED);
+	return key;
+}
+
+// Content-addressed front end to a SlabAllocator. Payloads are keyed by a hash of their bytes
+// (plus size and alignment); uploading the same bytes again returns the range already on the
+// GPU and bumps its reference count instead of allocating. Meshes that differ only in vertex
+// data end up sharing one index range, since their index payloads hash the same. A second hash
+// with a different seed guards against the rare 64-bit collision; on a mismatch the payload
+// simply gets a range of its own.
+class GeometryRegistry
+{
+public:
+	explicit GeometryRegistry(SlabAllocator& slabs)
+		: slabs(slabs), savedBytes(0), sharedCount(0)
+	{
+	}
+
+	GeometryRegistry(const GeometryRegistry&) = delete;
+	GeometryRegistry& operator=(const GeometryRegistry&) = delete;
+
+	// a range holding exactly these bytes, shared if identical content is already resident
+	SlabRange acquire(const void* data, uint32_t size, uint32_t alignment)
+	{
+		return acquire(data, size, alignment, geometryKeyOf(data, size, alignment));
+	}
+
+	// The same with the key computed beforehand. With data null nothing is written: written is
+	// set to false when the range is new and the caller still has to fill it through the slabs'
+	// upload(). Such a range is not shared with anyone until the caller hands it to publish().
+	SlabRange acquire(const void* data, uint32_t size, uint32_t alignment, const GeometryKey& geometryKey, bool* written = nullptr)
+	{
+		uint64_t key = geometryKey.key;
+		if (written)
+			*written = true;
+
+		auto found = entries.find(key);
+		if (found != entries.end())
+		{
+			Entry& entry = found->second;
+			if (entry.check == geometryKey.check && entry.size == size && entry.alignment == alignment && slabs.valid(entry.range))
+			{
+				entry.references++;
+				savedBytes += size;
+				sharedCount++;
+				return entry.range;
+			}
+			// a different payload with the same key: not shared
+			if (written)
+				*written = data != nullptr;
+			return slabs.allocate(size, alignment, data);
+		}
+
+		if (written)
+			*written = data != nullptr;
+		if (!data)
+			return slabs.allocate(size, alignment, nullptr);
+		Entry entry;
+		entry.check = geometryKey.check;
+		entry.size = size;
+		entry.alignment = alignment;
+		entry.references = 1;
+		entry.range = slabs.allocate(size, alignment, data);
+		if (!slabs.valid(entry.range))
+			return entry.range;
+		entries[key] = entry;
+		keyOfRange[entry.range.index] = key;
+		return entry.range;
+	}
+
+	// Registers a range that acquire() handed out unwritten, once all its bytes are in place, so
+	// later payloads with the same key share it. If identical content was registered meanwhile
+	// the range simply stays unshared.
+	void publish(SlabRange range, uint32_t size, uint32_t alignment, const GeometryKey& geometryKey)
+	{
+		if (!slabs.valid(range) || entries.count(geometryKey.key) || keyOfRange.count(range.index))
+			return;
+		Entry entry;
+		entry.check = geometryKey.check;
+		entry.size = size;
+		entry.alignment = alignment;
+		entry.references = 1;
+		entry.range = range;
+		entries[geometryKey.key] = entry;
+		keyOfRange[range.index] = geometryKey.key;
+	}
+
+	// drops one reference; the range is freed with the last one
+	void release(SlabRange range)
+	{
+		if (!slabs.valid(range))
+			return;
+		auto key = keyOfRange.find(range.index);
+		if (key == keyOfRange.end())
+		{
+			slabs.free(range);
+			return;
+		}
+		Entry& entry = entries[key->second];
+		if (--entry.references > 0)
+		{
+			savedBytes -= entry.size;
+			sharedCount--;
+			return;
+		}
+		slabs.free(range);
+		entries.erase(key->second);
+		keyOfRange.erase(key);
+	}
+
+	// bytes that did not have to be uploaded because identical content was already resident
+	uint64_t bytesSaved() const
+	{
+		return savedBytes;
+	}
+
+	// how many acquisitions are currently served by an existing range
+	uint32_t sharedRanges() const
+	{
+		return sharedCount;
+	}
+
+private:
+	struct Entry
+	{
+		uint64_t check = 0;
+		uint32_t size = 0;
+		uint32_t alignment = 0;
+		uint32_t references = 0;
+		SlabRange range;
+	};
+
+	SlabAllocator& slabs;
+	std::unordered_map<uint64_t, Entry> entries;
+	std::unordered_map<uint32_t, uint64_t> keyOfRange;
+	uint64_t savedBytes;
+	uint32_t sharedCount;
+};
+#endif
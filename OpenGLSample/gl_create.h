@@ -0,0 +1,151 @@
+#ifndef GL_CREATE_H
+#define GL_CREATE_H
+
+#include <glad/glad.h>
+
+#include "gl_ext.h"
+#include "gl_state.h"
+
+// Creation of buffers and textures whose size and format are fixed once they exist.
+// Storage is allocated immutably (glBufferStorage / glTexStorage2D with the exact mip count),
+// so the driver knows up front it will never have to reallocate and validates the object once.
+// On GL 4.5 the objects are created and filled through direct state access and nothing is
+// bound at all. Otherwise they are bound to edit on bindings nothing draws from (the copy-write
+// buffer target, a scratch texture unit) and unbound again, so no binding leaks into the render
+// loop. On a 3.3 context the storage is mutable but sized the same way.
+
+// texture unit used only to edit textures on the bind-to-edit path; never sampled from
+const GLuint SCRATCH_TEXTURE_UNIT = GLStateCache::MAX_UNITS - 1;
+
+// number of levels in a full mip chain down to 1x1
+inline GLsizei mipLevelCount(GLsizei width, GLsizei height)
+{
+	GLsizei size = width > height ? width : height;
+	GLsizei levels = 1;
+	while (size > 1)
+	{
+		size >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+// Creates a buffer of size bytes initialized from data (may be NULL). flags are glBufferStorage
+// flags: 0 for contents that never change, GL_DYNAMIC_STORAGE_BIT to allow glBufferSubData.
+inline GLuint createBuffer(GLsizeiptr size, const void* data, GLbitfield flags = 0)
+{
+	const GLExtensions& ext = glExt();
+	GLuint buffer = 0;
+	if (ext.directStateAccess)
+	{
+		ext.CreateBuffers(1, &buffer);
+		ext.NamedBufferStorage(buffer, size, data, flags);
+		return buffer;
+	}
+
+	// the copy-write target is not part of any VAO, so this cannot replace an element buffer
+	glGenBuffers(1, &buffer);
+	glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (ext.bufferStorage)
+		ext.BufferStorage(GL_COPY_WRITE_BUFFER, size, data, flags);
+	else
+		glBufferData(GL_COPY_WRITE_BUFFER, size, data, (flags & GL_DYNAMIC_STORAGE_BIT) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+	glState().bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return buffer;
+}
+
+// Creates a 2D texture of width x height in internalFormat (a sized format such as GL_RGBA8) from
+// pixels given in format/type. With mipmapped set, all mipLevelCount() levels are allocated and
+// generated from level 0 and trilinear filtering is used.
+inline GLuint createTexture2D(GLsizei width, GLsizei height, GLenum internalFormat, GLenum format, GLenum type,
+	const void* pixels, bool mipmapped = true, GLint wrap = GL_REPEAT)
+{
+	const GLExtensions& ext = glExt();
+	GLsizei levels = mipmapped ? mipLevelCount(width, height) : 1;
+	GLint minFilter = mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+	GLuint texture = 0;
+	if (ext.directStateAccess)
+	{
+		ext.CreateTextures(GL_TEXTURE_2D, 1, &texture);
+		ext.TextureStorage2D(texture, levels, internalFormat, width, height);
+		ext.TextureSubImage2D(texture, 0, 0, 0, width, height, format, type, pixels);
+		if (levels > 1)
+			ext.GenerateTextureMipmap(texture);
+		ext.TextureParameteri(texture, GL_TEXTURE_WRAP_S, wrap);
+		ext.TextureParameteri(texture, GL_TEXTURE_WRAP_T, wrap);
+		ext.TextureParameteri(texture, GL_TEXTURE_MIN_FILTER, minFilter);
+		ext.TextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return texture;
+	}
+
+	glGenTextures(1, &texture);
+	glState().bindTexture(SCRATCH_TEXTURE_UNIT, GL_TEXTURE_2D, texture);
+	if (ext.textureStorage)
+	{
+		ext.TexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type, pixels);
+	}
+	else
+	{
+		// mutable storage: cap the chain so the texture is complete with exactly these levels
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, pixels);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	}
+	if (levels > 1)
+		glGenerateMipmap(GL_TEXTURE_2D);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glState().bindTexture(SCRATCH_TEXTURE_UNIT, GL_TEXTURE_2D, 0);
+	return texture;
+}
+
+// Creates a 2D array texture of `layers` layers of width x height, filled layer by layer from
+// layerPixels (an entry may be NULL to leave that layer undefined). Mipmaps, filtering and wrap
+// as createTexture2D; every layer has its own mip chain and filtering never crosses layers.
+inline GLuint createTextureArray(GLsizei width, GLsizei height, GLsizei layers, GLenum internalFormat, GLenum format, GLenum type,
+	const void* const* layerPixels, bool mipmapped = true, GLint wrap = GL_REPEAT)
+{
+	const GLExtensions& ext = glExt();
+	GLsizei levels = mipmapped ? mipLevelCount(width, height) : 1;
+	GLint minFilter = mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+	GLuint texture = 0;
+	if (ext.directStateAccess)
+	{
+		ext.CreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+		ext.TextureStorage3D(texture, levels, internalFormat, width, height, layers);
+		for (GLsizei layer = 0; layer < layers; layer++)
+			if (layerPixels[layer] != NULL)
+				ext.TextureSubImage3D(texture, 0, 0, 0, layer, width, height, 1, format, type, layerPixels[layer]);
+		if (levels > 1)
+			ext.GenerateTextureMipmap(texture);
+		ext.TextureParameteri(texture, GL_TEXTURE_WRAP_S, wrap);
+		ext.TextureParameteri(texture, GL_TEXTURE_WRAP_T, wrap);
+		ext.TextureParameteri(texture, GL_TEXTURE_MIN_FILTER, minFilter);
+		ext.TextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return texture;
+	}
+
+	glGenTextures(1, &texture);
+	glState().bindTexture(SCRATCH_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, texture);
+	if (ext.textureStorage)
+		ext.TexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, layers);
+	else
+	{
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalFormat, width, height, layers, 0, format, type, NULL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	}
+	for (GLsizei layer = 0; layer < layers; layer++)
+		if (layerPixels[layer] != NULL)
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, format, type, layerPixels[layer]);
+	if (levels > 1)
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, minFilter);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glState().bindTexture(SCRATCH_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, 0);
+	return texture;
+}
+#endif
\ No newline at end of file
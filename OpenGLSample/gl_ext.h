@@ -0,0 +1,133 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// The glad loader in this project is generated for GL 4.3 core with no extensions, so
+// the newer entry points we take advantage of when the driver offers them are loaded here.
+// Every caller must check the matching flag and keep a 3.3 path for when it is false.
+
+// GL 4.4 / ARB_buffer_storage
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+#ifndef GL_CLIENT_STORAGE_BIT
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+typedef void (APIENTRYP GLExtBufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// GL 4.2 / ARB_texture_storage
+typedef void (APIENTRYP GLExtTexStorage2DProc)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP GLExtTexStorage3DProc)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+
+// GL 4.5 / ARB_direct_state_access, the subset used to create resources without binding them
+typedef void (APIENTRYP GLExtCreateBuffersProc)(GLsizei n, GLuint* buffers);
+typedef void (APIENTRYP GLExtNamedBufferStorageProc)(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags);
+typedef void (APIENTRYP GLExtCreateTexturesProc)(GLenum target, GLsizei n, GLuint* textures);
+typedef void (APIENTRYP GLExtTextureStorage2DProc)(GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP GLExtTextureSubImage2DProc)(GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels);
+typedef void (APIENTRYP GLExtTextureStorage3DProc)(GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+typedef void (APIENTRYP GLExtTextureSubImage3DProc)(GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels);
+typedef void (APIENTRYP GLExtGenerateTextureMipmapProc)(GLuint texture);
+typedef void (APIENTRYP GLExtTextureParameteriProc)(GLuint texture, GLenum pname, GLint param);
+
+// GL 4.4 / ARB_multi_bind
+typedef void (APIENTRYP GLExtBindTexturesProc)(GLuint first, GLsizei count, const GLuint* textures);
+
+struct GLExtensions
+{
+	bool bufferStorage = false;
+	GLExtBufferStorageProc BufferStorage = nullptr;
+
+	bool textureStorage = false;
+	GLExtTexStorage2DProc TexStorage2D = nullptr;
+	GLExtTexStorage3DProc TexStorage3D = nullptr;
+
+	bool directStateAccess = false;
+	GLExtCreateBuffersProc CreateBuffers = nullptr;
+	GLExtNamedBufferStorageProc NamedBufferStorage = nullptr;
+	GLExtCreateTexturesProc CreateTextures = nullptr;
+	GLExtTextureStorage2DProc TextureStorage2D = nullptr;
+	GLExtTextureSubImage2DProc TextureSubImage2D = nullptr;
+	GLExtTextureStorage3DProc TextureStorage3D = nullptr;
+	GLExtTextureSubImage3DProc TextureSubImage3D = nullptr;
+	GLExtGenerateTextureMipmapProc GenerateTextureMipmap = nullptr;
+	GLExtTextureParameteriProc TextureParameteri = nullptr;
+
+	bool multiBind = false;
+	GLExtBindTexturesProc BindTextures = nullptr;
+};
+
+// process-wide table, filled once by loadGLExtensions() right after glad is initialized
+inline GLExtensions& glExt()
+{
+	static GLExtensions extensions;
+	return extensions;
+}
+
+// true if the current context is at least the requested version
+inline bool glVersionAtLeast(int major, int minor)
+{
+	return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+// true if the driver advertises the named extension
+inline bool glHasExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension != NULL && strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+// loads the post-4.3 entry points; call after gladLoadGLLoader with the same loader
+inline void loadGLExtensions(GLADloadproc load)
+{
+	GLExtensions& ext = glExt();
+
+	if (glVersionAtLeast(4, 4) || glHasExtension("GL_ARB_buffer_storage"))
+		ext.BufferStorage = (GLExtBufferStorageProc)load("glBufferStorage");
+	ext.bufferStorage = ext.BufferStorage != nullptr;
+
+	if (glVersionAtLeast(4, 2) || glHasExtension("GL_ARB_texture_storage"))
+	{
+		ext.TexStorage2D = (GLExtTexStorage2DProc)load("glTexStorage2D");
+		ext.TexStorage3D = (GLExtTexStorage3DProc)load("glTexStorage3D");
+	}
+	ext.textureStorage = ext.TexStorage2D && ext.TexStorage3D;
+
+	if (glVersionAtLeast(4, 5) || glHasExtension("GL_ARB_direct_state_access"))
+	{
+		ext.CreateBuffers = (GLExtCreateBuffersProc)load("glCreateBuffers");
+		ext.NamedBufferStorage = (GLExtNamedBufferStorageProc)load("glNamedBufferStorage");
+		ext.CreateTextures = (GLExtCreateTexturesProc)load("glCreateTextures");
+		ext.TextureStorage2D = (GLExtTextureStorage2DProc)load("glTextureStorage2D");
+		ext.TextureSubImage2D = (GLExtTextureSubImage2DProc)load("glTextureSubImage2D");
+		ext.TextureStorage3D = (GLExtTextureStorage3DProc)load("glTextureStorage3D");
+		ext.TextureSubImage3D = (GLExtTextureSubImage3DProc)load("glTextureSubImage3D");
+		ext.GenerateTextureMipmap = (GLExtGenerateTextureMipmapProc)load("glGenerateTextureMipmap");
+		ext.TextureParameteri = (GLExtTextureParameteriProc)load("glTextureParameteri");
+	}
+	// all or nothing: a half-loaded table would mix DSA and bind-to-edit on one object
+	ext.directStateAccess = ext.CreateBuffers && ext.NamedBufferStorage && ext.CreateTextures && ext.TextureStorage2D
+		&& ext.TextureSubImage2D && ext.TextureStorage3D && ext.TextureSubImage3D && ext.GenerateTextureMipmap && ext.TextureParameteri;
+
+	if (glVersionAtLeast(4, 4) || glHasExtension("GL_ARB_multi_bind"))
+		ext.BindTextures = (GLExtBindTexturesProc)load("glBindTextures");
+	ext.multiBind = ext.BindTextures != nullptr;
+}
+#endif
@@ -0,0 +1,366 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include "gl_ext.h"
+
+#include <utility>
+#include <vector>
+
+// calls that reached the driver vs calls skipped because the state was already set
+struct GLStateStats
+{
+	unsigned int issued = 0;
+	unsigned int elided = 0;
+};
+
+// Thin shadow of the GL binding state. Every engine path binds programs, VAOs, buffers,
+// textures and samplers and toggles capabilities through it, so a call that would not change
+// anything never reaches the driver. Anything that changes this state behind its back must call
+// invalidate(), and deleting an object must go through the matching forget*() so a recycled
+// name is not mistaken for the old binding.
+class GLStateCache
+{
+public:
+	static const GLuint UNKNOWN = 0xFFFFFFFFu;
+	static const unsigned int MAX_UNITS = 32;
+	static const unsigned int MAX_INDEXED_BINDINGS = 16;
+
+	GLStateCache()
+	{
+		invalidate();
+	}
+
+	// forgets everything, so the next call of each kind is issued
+	void invalidate()
+	{
+		program = UNKNOWN;
+		vertexArray = UNKNOWN;
+		elementBuffer = UNKNOWN;
+		activeUnit = UNKNOWN;
+		for (int i = 0; i < TARGET_COUNT; i++)
+			buffers[i] = UNKNOWN;
+		for (unsigned int unit = 0; unit < MAX_UNITS; unit++)
+		{
+			for (int i = 0; i < TEXTURE_TARGET_COUNT; i++)
+				textures[unit][i] = UNKNOWN;
+			samplers[unit] = UNKNOWN;
+		}
+		for (unsigned int i = 0; i < MAX_INDEXED_BINDINGS; i++)
+			uniformBindings[i] = IndexedBinding();
+		capabilities.clear();
+		textureChanges++;
+	}
+
+	// ------------------------------------------------------------------------
+	void useProgram(GLuint id)
+	{
+		if (program == id)
+		{
+			current.elided++;
+			return;
+		}
+		glUseProgram(id);
+		program = id;
+		current.issued++;
+	}
+
+	// ------------------------------------------------------------------------
+	void bindVertexArray(GLuint id)
+	{
+		if (vertexArray == id)
+		{
+			current.elided++;
+			return;
+		}
+		glBindVertexArray(id);
+		vertexArray = id;
+		// the element array binding is part of the VAO
+		elementBuffer = UNKNOWN;
+		current.issued++;
+	}
+
+	// ------------------------------------------------------------------------
+	void bindBuffer(GLenum target, GLuint id)
+	{
+		GLuint* bound = boundBuffer(target);
+		if (bound && *bound == id)
+		{
+			current.elided++;
+			return;
+		}
+		glBindBuffer(target, id);
+		if (bound)
+			*bound = id;
+		current.issued++;
+	}
+
+	// indexed buffer bindings; like the GL calls these also set the generic binding of the target
+	void bindBufferRange(GLenum target, GLuint index, GLuint id, GLintptr offset, GLsizeiptr size)
+	{
+		if (!updateIndexedBinding(target, index, id, offset, size))
+		{
+			current.elided++;
+			return;
+		}
+		glBindBufferRange(target, index, id, offset, size);
+		current.issued++;
+	}
+
+	void bindBufferBase(GLenum target, GLuint index, GLuint id)
+	{
+		// a size of -1 marks a whole-buffer binding, which never equals a real range
+		if (!updateIndexedBinding(target, index, id, 0, -1))
+		{
+			current.elided++;
+			return;
+		}
+		glBindBufferBase(target, index, id);
+		current.issued++;
+	}
+
+	// ------------------------------------------------------------------------
+	void activeTexture(GLuint unit)
+	{
+		if (activeUnit == unit)
+		{
+			current.elided++;
+			return;
+		}
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+		current.issued++;
+	}
+
+	// binds texture to target on unit, switching the active unit only if the binding changes;
+	// units from MAX_UNITS up are not tracked and always issued
+	void bindTexture(GLuint unit, GLenum target, GLuint id)
+	{
+		int index = unit < MAX_UNITS ? textureTargetIndex(target) : -1;
+		if (index >= 0 && textures[unit][index] == id)
+		{
+			current.elided++;
+			return;
+		}
+		activeTexture(unit);
+		glBindTexture(target, id);
+		if (index >= 0)
+			textures[unit][index] = id;
+		textureChanges++;
+		current.issued++;
+	}
+
+	// Binds ids[i] to target on unit first + i, the textures all of that target. With
+	// ARB_multi_bind the units that change are set by one glBindTextures call and the active
+	// unit is left alone; without it each goes through bindTexture().
+	void bindTextures(GLuint first, GLsizei count, GLenum target, const GLuint* ids)
+	{
+		int index = textureTargetIndex(target);
+		bool changed = index < 0 || first + (GLuint)count > MAX_UNITS;
+		for (GLsizei i = 0; i < count && !changed; i++)
+			changed = textures[first + i][index] != ids[i];
+		if (!changed)
+		{
+			current.elided++;
+			return;
+		}
+		if (!glExt().multiBind)
+		{
+			for (GLsizei i = 0; i < count; i++)
+				bindTexture(first + (GLuint)i, target, ids[i]);
+			return;
+		}
+		glExt().BindTextures(first, count, ids);
+		if (index >= 0)
+			for (GLsizei i = 0; i < count && first + (GLuint)i < MAX_UNITS; i++)
+				textures[first + i][index] = ids[i];
+		textureChanges++;
+		current.issued++;
+	}
+
+	// bumped by every texture binding that reaches the driver; equal values mean nothing was rebound
+	unsigned int textureBindingChanges() const
+	{
+		return textureChanges;
+	}
+
+	void bindSampler(GLuint unit, GLuint id)
+	{
+		if (unit < MAX_UNITS && samplers[unit] == id)
+		{
+			current.elided++;
+			return;
+		}
+		glBindSampler(unit, id);
+		if (unit < MAX_UNITS)
+			samplers[unit] = id;
+		current.issued++;
+	}
+
+	// ------------------------------------------------------------------------
+	void enable(GLenum capability)
+	{
+		setCapability(capability, true);
+	}
+
+	void disable(GLenum capability)
+	{
+		setCapability(capability, false);
+	}
+
+	// ------------------------------------------------------------------------
+	// call after glDelete* so a recycled name is not taken for the old binding
+	void forgetProgram(GLuint id)
+	{
+		if (program == id)
+			program = UNKNOWN;
+	}
+
+	void forgetVertexArray(GLuint id)
+	{
+		if (vertexArray == id)
+			vertexArray = UNKNOWN;
+	}
+
+	void forgetBuffer(GLuint id)
+	{
+		if (elementBuffer == id)
+			elementBuffer = UNKNOWN;
+		for (int i = 0; i < TARGET_COUNT; i++)
+			if (buffers[i] == id)
+				buffers[i] = UNKNOWN;
+		for (unsigned int i = 0; i < MAX_INDEXED_BINDINGS; i++)
+			if (uniformBindings[i].buffer == id)
+				uniformBindings[i] = IndexedBinding();
+	}
+
+	void forgetTexture(GLuint id)
+	{
+		for (unsigned int unit = 0; unit < MAX_UNITS; unit++)
+			for (int i = 0; i < TEXTURE_TARGET_COUNT; i++)
+				if (textures[unit][i] == id)
+					textures[unit][i] = UNKNOWN;
+		textureChanges++;
+	}
+
+	// ------------------------------------------------------------------------
+	// closes the current frame's counters; lastFrame() then reports them
+	void endFrame()
+	{
+		previous = current;
+		current = GLStateStats();
+	}
+
+	const GLStateStats& lastFrame() const
+	{
+		return previous;
+	}
+
+private:
+	struct IndexedBinding
+	{
+		GLuint buffer = UNKNOWN;
+		GLintptr offset = 0;
+		GLsizeiptr size = 0;
+	};
+
+	enum { TARGET_COUNT = 8, TEXTURE_TARGET_COUNT = 4 };
+
+	GLuint program;
+	GLuint vertexArray;
+	GLuint elementBuffer;
+	GLuint activeUnit;
+	GLuint buffers[TARGET_COUNT];
+	GLuint textures[MAX_UNITS][TEXTURE_TARGET_COUNT];
+	GLuint samplers[MAX_UNITS];
+	unsigned int textureChanges = 0;
+	IndexedBinding uniformBindings[MAX_INDEXED_BINDINGS];
+	std::vector<std::pair<GLenum, bool> > capabilities;
+	GLStateStats current;
+	GLStateStats previous;
+
+	// slot shadowing the generic binding of target, or null for targets that are not tracked
+	GLuint* boundBuffer(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_ELEMENT_ARRAY_BUFFER: return &elementBuffer;
+		case GL_ARRAY_BUFFER: return &buffers[0];
+		case GL_UNIFORM_BUFFER: return &buffers[1];
+		case GL_TEXTURE_BUFFER: return &buffers[2];
+		case GL_COPY_READ_BUFFER: return &buffers[3];
+		case GL_COPY_WRITE_BUFFER: return &buffers[4];
+		case GL_DRAW_INDIRECT_BUFFER: return &buffers[5];
+		case GL_SHADER_STORAGE_BUFFER: return &buffers[6];
+		case GL_PIXEL_UNPACK_BUFFER: return &buffers[7];
+		default: return nullptr;
+		}
+	}
+
+	static int textureTargetIndex(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_TEXTURE_2D: return 0;
+		case GL_TEXTURE_2D_ARRAY: return 1;
+		case GL_TEXTURE_BUFFER: return 2;
+		case GL_TEXTURE_CUBE_MAP: return 3;
+		default: return -1; // not tracked, always issued
+		}
+	}
+
+	// records an indexed binding; false if it was already in place
+	bool updateIndexedBinding(GLenum target, GLuint index, GLuint id, GLintptr offset, GLsizeiptr size)
+	{
+		if (target == GL_UNIFORM_BUFFER && index < MAX_INDEXED_BINDINGS)
+		{
+			IndexedBinding& binding = uniformBindings[index];
+			if (binding.buffer == id && binding.offset == offset && binding.size == size)
+				return false;
+			binding.buffer = id;
+			binding.offset = offset;
+			binding.size = size;
+		}
+		GLuint* bound = boundBuffer(target);
+		if (bound)
+			*bound = id;
+		return true;
+	}
+
+	void setCapability(GLenum capability, bool enabled)
+	{
+		for (std::pair<GLenum, bool>& entry : capabilities)
+		{
+			if (entry.first != capability)
+				continue;
+			if (entry.second == enabled)
+			{
+				current.elided++;
+				return;
+			}
+			entry.second = enabled;
+			issueCapability(capability, enabled);
+			return;
+		}
+		capabilities.push_back(std::make_pair(capability, enabled));
+		issueCapability(capability, enabled);
+	}
+
+	void issueCapability(GLenum capability, bool enabled)
+	{
+		if (enabled)
+			glEnable(capability);
+		else
+			glDisable(capability);
+		current.issued++;
+	}
+};
+
+// the one cache for the one context this program creates
+inline GLStateCache& glState()
+{
+	static GLStateCache cache;
+	return cache;
+}
+#endif
@@ -0,0 +1,430 @@
+#ifndef GPU_RESOURCES_H
+#define GPU_RESOURCES_H
+
+#include <glad/glad.h>
+
+#include "gl_create.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Ownership and accounting of every GL object the program creates.
+//
+// Objects are registered with the registry, which hands back a GpuHandle: a slot index plus the
+// slot's generation. Releasing a handle bumps the generation, so a stale copy can never reach a
+// recycled slot. Owners hold their handle in a move-only GpuResource, which releases it when it
+// goes out of scope. The GL delete itself is deferred: released objects are fenced at the end of
+// the frame and only deleted once the GPU has passed that fence, so a draw still in flight never
+// reads a deleted buffer. Every object carries its size in one of the memory categories, which is
+// what report() prints to answer where the video memory is going.
+
+enum class ResourceKind { Buffer, Texture, VertexArray, Program };
+
+enum class MemoryCategory { Vertex, Index, Uniform, Texture, Program, Count };
+
+const int MEMORY_CATEGORY_COUNT = (int)MemoryCategory::Count;
+
+inline const char* memoryCategoryName(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::Vertex: return "vertex";
+	case MemoryCategory::Index: return "index";
+	case MemoryCategory::Uniform: return "uniform";
+	case MemoryCategory::Texture: return "texture";
+	case MemoryCategory::Program: return "program";
+	default: return "unknown";
+	}
+}
+
+// category a buffer bound to target is accounted under
+inline MemoryCategory memoryCategoryForTarget(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return MemoryCategory::Vertex;
+	case GL_ELEMENT_ARRAY_BUFFER: return MemoryCategory::Index;
+	default: return MemoryCategory::Uniform;
+	}
+}
+
+// bytes per texel of a sized internal format as the driver stores it
+inline size_t textureFormatBytes(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_R8: return 1;
+	case GL_RG8: return 2;
+	case GL_RGB8: return 4; // padded to four bytes by desktop drivers
+	case GL_RGBA8: return 4;
+	case GL_RGBA16F: return 8;
+	case GL_RGBA32F: return 16;
+	default: return 4;
+	}
+}
+
+// a slot index and the generation it was issued in; generation 0 never names a live object
+struct GpuHandle
+{
+	uint32_t index = 0;
+	uint32_t generation = 0;
+};
+
+class GpuResourceRegistry
+{
+public:
+	GpuResourceRegistry()
+		: closed(false)
+	{
+		for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+		{
+			liveBytes[i] = 0;
+			liveCount[i] = 0;
+			pendingBytes[i] = 0;
+		}
+	}
+
+	GpuResourceRegistry(const GpuResourceRegistry&) = delete;
+	GpuResourceRegistry& operator=(const GpuResourceRegistry&) = delete;
+
+	// takes ownership of an existing GL object of kind named name
+	GpuHandle add(ResourceKind kind, GLuint name, MemoryCategory category, size_t bytes, const std::string& label)
+	{
+		if (closed || name == 0)
+			return GpuHandle();
+		uint32_t index;
+		if (!freeSlots.empty())
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			index = (uint32_t)slots.size();
+			slots.push_back(Slot());
+		}
+		Slot& slot = slots[index];
+		slot.object.kind = kind;
+		slot.object.name = name;
+		slot.object.category = category;
+		slot.object.bytes = bytes;
+		slot.label = label;
+		slot.live = true;
+		liveBytes[(int)category] += bytes;
+		liveCount[(int)category]++;
+
+		GpuHandle handle;
+		handle.index = index;
+		handle.generation = slot.generation;
+		return handle;
+	}
+
+	bool valid(GpuHandle handle) const
+	{
+		return handle.generation != 0 && handle.index < slots.size()
+			&& slots[handle.index].live && slots[handle.index].generation == handle.generation;
+	}
+
+	// the GL name behind handle, or 0 if the handle is stale
+	GLuint name(GpuHandle handle) const
+	{
+		return valid(handle) ? slots[handle.index].object.name : 0;
+	}
+
+	// gives the object up; it is deleted once the GPU is done with the current frame.
+	// Stale handles are ignored, so releasing twice or after shutdown() is harmless.
+	void release(GpuHandle handle)
+	{
+		if (!valid(handle))
+			return;
+		Slot& slot = slots[handle.index];
+		int category = (int)slot.object.category;
+		liveBytes[category] -= slot.object.bytes;
+		liveCount[category]--;
+		pendingBytes[category] += slot.object.bytes;
+		retiring.push_back(slot.object);
+
+		slot.live = false;
+		slot.label.clear();
+		slot.generation++;
+		if (slot.generation == 0)
+			slot.generation = 1;
+		freeSlots.push_back(handle.index);
+	}
+
+	// fences the objects released this frame; call after the frame's last draw
+	void endFrame()
+	{
+		if (retiring.empty())
+			return;
+		Batch batch;
+		batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		batch.objects.swap(retiring);
+		batches.push_back(batch);
+	}
+
+	// deletes the objects whose fence has been passed; call once per frame
+	void collect()
+	{
+		size_t done = 0;
+		while (done < batches.size())
+		{
+			Batch& batch = batches[done];
+			if (glClientWaitSync(batch.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+				break;
+			glDeleteSync(batch.fence);
+			for (const Object& object : batch.objects)
+				destroy(object);
+			done++;
+		}
+		batches.erase(batches.begin(), batches.begin() + done);
+	}
+
+	// deletes everything, live or pending, while the context still exists.
+	// Owners that go out of scope afterwards hold stale handles and do nothing.
+	void shutdown()
+	{
+		glFinish();
+		for (Batch& batch : batches)
+		{
+			glDeleteSync(batch.fence);
+			for (const Object& object : batch.objects)
+				destroy(object);
+		}
+		batches.clear();
+		for (const Object& object : retiring)
+			destroy(object);
+		retiring.clear();
+		for (uint32_t i = 0; i < slots.size(); i++)
+		{
+			if (!slots[i].live)
+				continue;
+			GpuHandle handle;
+			handle.index = i;
+			handle.generation = slots[i].generation;
+			release(handle);
+		}
+		for (const Object& object : retiring)
+			destroy(object);
+		retiring.clear();
+		closed = true;
+	}
+
+	size_t bytes(MemoryCategory category) const
+	{
+		return liveBytes[(int)category];
+	}
+
+	size_t totalBytes() const
+	{
+		size_t total = 0;
+		for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+			total += liveBytes[i];
+		return total;
+	}
+
+	// live objects and bytes per category, plus what is released but not yet deleted;
+	// perObject also lists every live object with its label
+	void report(std::ostream& out, bool perObject = false) const
+	{
+		out << "GPU memory: " << totalBytes() / 1024 << " KiB in use" << std::endl;
+		for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+		{
+			out << "  " << memoryCategoryName((MemoryCategory)i) << ": " << liveCount[i] << " objects, "
+				<< liveBytes[i] / 1024 << " KiB";
+			if (pendingBytes[i])
+				out << " (+" << pendingBytes[i] / 1024 << " KiB awaiting delete)";
+			out << std::endl;
+		}
+		if (!perObject)
+			return;
+		for (const Slot& slot : slots)
+		{
+			if (!slot.live)
+				continue;
+			out << "    [" << memoryCategoryName(slot.object.category) << "] "
+				<< (slot.label.empty() ? "(unnamed)" : slot.label) << ": " << slot.object.bytes << " bytes" << std::endl;
+		}
+	}
+
+private:
+	struct Object
+	{
+		ResourceKind kind = ResourceKind::Buffer;
+		GLuint name = 0;
+		MemoryCategory category = MemoryCategory::Vertex;
+		size_t bytes = 0;
+	};
+
+	struct Slot
+	{
+		Object object;
+		std::string label;
+		uint32_t generation = 1;
+		bool live = false;
+	};
+
+	struct Batch
+	{
+		GLsync fence;
+		std::vector<Object> objects;
+	};
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	std::vector<Object> retiring;
+	std::vector<Batch> batches;
+	size_t liveBytes[MEMORY_CATEGORY_COUNT];
+	size_t liveCount[MEMORY_CATEGORY_COUNT];
+	size_t pendingBytes[MEMORY_CATEGORY_COUNT];
+	bool closed;
+
+	void destroy(const Object& object)
+	{
+		switch (object.kind)
+		{
+		case ResourceKind::Buffer:
+			glDeleteBuffers(1, &object.name);
+			glState().forgetBuffer(object.name);
+			break;
+		case ResourceKind::Texture:
+			glDeleteTextures(1, &object.name);
+			glState().forgetTexture(object.name);
+			break;
+		case ResourceKind::VertexArray:
+			glDeleteVertexArrays(1, &object.name);
+			glState().forgetVertexArray(object.name);
+			break;
+		case ResourceKind::Program:
+			glDeleteProgram(object.name);
+			glState().forgetProgram(object.name);
+			break;
+		}
+		pendingBytes[(int)object.category] -= object.bytes;
+	}
+};
+
+// the registry for the one context this program creates
+inline GpuResourceRegistry& gpuResources()
+{
+	static GpuResourceRegistry registry;
+	return registry;
+}
+
+// Move-only owner of one registered object; releases it on destruction.
+class GpuResource
+{
+public:
+	GpuResource() {}
+
+	explicit GpuResource(GpuHandle handle)
+		: handle(handle)
+	{
+	}
+
+	~GpuResource()
+	{
+		reset();
+	}
+
+	GpuResource(const GpuResource&) = delete;
+	GpuResource& operator=(const GpuResource&) = delete;
+
+	GpuResource(GpuResource&& other) noexcept
+		: handle(other.handle)
+	{
+		other.handle = GpuHandle();
+	}
+
+	GpuResource& operator=(GpuResource&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			handle = other.handle;
+			other.handle = GpuHandle();
+		}
+		return *this;
+	}
+
+	// the GL name, or 0 if empty or already released
+	GLuint id() const
+	{
+		return gpuResources().name(handle);
+	}
+
+	explicit operator bool() const
+	{
+		return gpuResources().valid(handle);
+	}
+
+	void reset()
+	{
+		gpuResources().release(handle);
+		handle = GpuHandle();
+	}
+
+private:
+	GpuHandle handle;
+};
+
+// ------------------------------------------------------------------------
+// creation helpers: the gl_create.h paths, registered and owned
+
+inline GpuResource makeBuffer(MemoryCategory category, GLsizeiptr size, const void* data, GLbitfield flags = 0, const std::string& label = "")
+{
+	GLuint buffer = createBuffer(size, data, flags);
+	return GpuResource(gpuResources().add(ResourceKind::Buffer, buffer, category, (size_t)size, label));
+}
+
+inline GpuResource makeTexture2D(GLsizei width, GLsizei height, GLenum internalFormat, GLenum format, GLenum type,
+	const void* pixels, bool mipmapped = true, GLint wrap = GL_REPEAT, const std::string& label = "")
+{
+	GLuint texture = createTexture2D(width, height, internalFormat, format, type, pixels, mipmapped, wrap);
+	size_t bytes = 0;
+	GLsizei levels = mipmapped ? mipLevelCount(width, height) : 1;
+	for (GLsizei level = 0; level < levels; level++)
+	{
+		size_t levelWidth = std::max(width >> level, 1);
+		size_t levelHeight = std::max(height >> level, 1);
+		bytes += levelWidth * levelHeight * textureFormatBytes(internalFormat);
+	}
+	return GpuResource(gpuResources().add(ResourceKind::Texture, texture, MemoryCategory::Texture, bytes, label));
+}
+
+inline GpuResource makeTextureArray(GLsizei width, GLsizei height, GLsizei layers, GLenum internalFormat, GLenum format, GLenum type,
+	const void* const* layerPixels, bool mipmapped = true, GLint wrap = GL_REPEAT, const std::string& label = "")
+{
+	GLuint texture = createTextureArray(width, height, layers, internalFormat, format, type, layerPixels, mipmapped, wrap);
+	size_t bytes = 0;
+	GLsizei levels = mipmapped ? mipLevelCount(width, height) : 1;
+	for (GLsizei level = 0; level < levels; level++)
+	{
+		size_t levelWidth = std::max(width >> level, 1);
+		size_t levelHeight = std::max(height >> level, 1);
+		bytes += levelWidth * levelHeight * textureFormatBytes(internalFormat);
+	}
+	return GpuResource(gpuResources().add(ResourceKind::Texture, texture, MemoryCategory::Texture, bytes * (size_t)layers, label));
+}
+
+inline GpuResource makeVertexArray(const std::string& label = "")
+{
+	GLuint vertexArray = 0;
+	glGenVertexArrays(1, &vertexArray);
+	return GpuResource(gpuResources().add(ResourceKind::VertexArray, vertexArray, MemoryCategory::Vertex, 0, label));
+}
+
+// takes ownership of a linked program; its size is the driver's binary length where GL 4.1 reports it
+inline GpuResource adoptProgram(GLuint program, const std::string& label = "")
+{
+	GLint length = 0;
+	if (GLAD_GL_VERSION_4_1)
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	return GpuResource(gpuResources().add(ResourceKind::Program, program, MemoryCategory::Program, (size_t)length, label));
+}
+#endif
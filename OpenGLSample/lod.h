@@ -0,0 +1,103 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <glm/glm.hpp>
+
+#include "mesh_pool.h"
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Discrete levels of detail. A chain holds the same object at decreasing detail, finest first,
+// each level tagged with its object-space error: how far its surface strays from the ideal
+// shape (or from the source mesh, for simplified levels). Selection projects that error to
+// pixels and takes the coarsest level that stays under the pixel threshold, so the choice
+// follows screen size rather than distance alone.
+
+struct LodLevel
+{
+	PooledMesh geometry;
+	GLsizei indexCount = 0;
+	float error = 0.0f;     // object-space deviation, never smaller than the previous level's
+	std::vector<Meshlet> meshlets;  // empty when the level is always drawn whole
+};
+
+struct LodChain
+{
+	std::vector<LodLevel> levels;   // finest first
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;           // bounding sphere in object space
+
+	void addLevel(const PooledMesh& geometry, GLsizei indexCount, float error, const std::vector<Meshlet>& meshlets = std::vector<Meshlet>())
+	{
+		LodLevel level;
+		level.geometry = geometry;
+		level.indexCount = indexCount;
+		level.error = error;
+		level.meshlets = meshlets;
+		levels.push_back(level);
+	}
+};
+
+struct LodSettings
+{
+	float pixelError = 1.0f;   // largest acceptable projected error, in pixels
+	float bias = 0.0f;         // each step up doubles the accepted error (coarser), each step down halves it
+	float hysteresis = 0.25f;  // a coarser level must undercut the threshold by this fraction before it is taken
+};
+
+// the camera as LOD selection sees it, built once per frame
+struct LodView
+{
+	glm::vec3 position = glm::vec3(0.0f);
+	float pixelsPerUnit = 1.0f; // pixels covered by one world unit at distance 1
+	float nearPlane = 0.1f;
+};
+
+inline LodView makeLodView(const glm::vec3& cameraPosition, const glm::mat4& projection, float viewportHeight, float nearPlane)
+{
+	LodView view;
+	view.position = cameraPosition;
+	view.pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+	view.nearPlane = nearPlane;
+	return view;
+}
+
+// how many pixels one object-space unit covers for this object, from its bounding sphere
+inline float lodPixelsPerUnit(const LodChain& chain, const glm::mat4& model, const LodView& view)
+{
+	float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	glm::vec3 center = glm::vec3(model * glm::vec4(chain.center, 1.0f));
+	// the nearest point of the sphere decides, so the error bound holds over the whole object
+	float distance = std::max(glm::length(center - view.position) - chain.radius * scale, view.nearPlane);
+	return view.pixelsPerUnit * scale / distance;
+}
+
+// the level to draw this frame, given the one drawn last frame
+inline int selectLod(const LodChain& chain, const glm::mat4& model, const LodView& view, const LodSettings& settings, int current)
+{
+	int count = (int)chain.levels.size();
+	if (count <= 1)
+		return 0;
+	current = std::max(0, std::min(current, count - 1));
+
+	float threshold = settings.pixelError * std::pow(2.0f, settings.bias);
+	float pixels = lodPixelsPerUnit(chain, model, view);
+
+	// finer while the current level shows too much error
+	while (current > 0 && chain.levels[current].error * pixels > threshold)
+		current--;
+	// coarser only with a margin, so an object near a boundary does not flip every frame
+	while (current + 1 < count && chain.levels[current + 1].error * pixels <= threshold * (1.0f - settings.hysteresis))
+		current++;
+	return current;
+}
+
+// error of a circle of the given radius drawn with this many segments (the sagitta)
+inline float circleLodError(float radius, int segments)
+{
+	return radius * (1.0f - std::cos(3.14159265f / (float)segments));
+}
+#endif
@@ -0,0 +1,203 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Materials for mesh.h's Mesh: a surface's textures and parameters, resolved once so a draw
+// binds them without touching a string. Every sampler name (texture_diffuse1,
+// texture_specular1, ...) gets a texture unit of its own the first time a material uses it. A
+// program's sampler uniforms are pointed at those units the first time it draws a material and
+// then left alone, since uniforms are program state. Drawing the material a program drew last,
+// with no texture rebound since, costs a comparison. A switch binds each run of consecutive units
+// with one glBindTextures call where ARB_multi_bind is available (one call for the usual
+// material, whose slots are numbered from 0), else one cached bind per texture, and sets the
+// shininess only when the program was last given another value.
+// Materials with the same textures in the same roles and the same parameters share a handle.
+
+struct Texture {
+	unsigned int id;
+	std::string type;   // texture_diffuse, texture_specular, texture_normal or texture_height
+	std::string path;
+};
+
+struct MaterialHandle
+{
+	uint32_t index = UINT32_MAX;
+
+	bool valid() const
+	{
+		return index != UINT32_MAX;
+	}
+};
+
+// sampler names beyond this many across all materials are not bound
+const uint32_t MAX_MATERIAL_SLOTS = 16;
+
+class MaterialLibrary
+{
+public:
+	// Registers the textures of a mesh, numbered per type in order (the first texture_diffuse is
+	// texture_diffuse1, the next texture_diffuse2), or returns the identical material already known.
+	MaterialHandle add(const std::vector<Texture>& textures, float shininess = 32.0f)
+	{
+		Material material;
+		material.shininess = shininess;
+		std::map<std::string, int> numbers;
+		for (const Texture& texture : textures)
+		{
+			std::string name = texture.type + std::to_string(++numbers[texture.type]);
+			uint32_t slot = slotFor(name);
+			if (slot < MAX_MATERIAL_SLOTS)
+				material.textures.push_back(std::make_pair(slot, (GLuint)texture.id));
+		}
+		std::sort(material.textures.begin(), material.textures.end());
+
+		uint32_t shininessBits;
+		memcpy(&shininessBits, &shininess, sizeof(shininessBits));
+		Key key(material.textures, shininessBits);
+		auto found = known.find(key);
+		if (found != known.end())
+			return found->second;
+
+		for (const std::pair<uint32_t, GLuint>& texture : material.textures)
+		{
+			if (material.runs.empty() || material.runs.back().first + material.runs.back().count != texture.first)
+			{
+				TextureRun run;
+				run.first = texture.first;
+				run.offset = (uint32_t)material.names.size();
+				material.runs.push_back(run);
+			}
+			material.runs.back().count++;
+			material.names.push_back(texture.second);
+		}
+
+		MaterialHandle handle;
+		handle.index = (uint32_t)materials.size();
+		materials.push_back(material);
+		known.emplace(key, handle);
+		return handle;
+	}
+
+	// binds the material for a draw with `program`, which must be in use
+	void bind(MaterialHandle handle, GLuint program)
+	{
+		if (!handle.valid() || handle.index >= materials.size())
+			return;
+		Program& state = resolve(program);
+		if (state.lastMaterial == handle.index && state.textureChanges == glState().textureBindingChanges())
+			return;
+		const Material& material = materials[handle.index];
+		for (const TextureRun& run : material.runs)
+			glState().bindTextures(run.first, (GLsizei)run.count, GL_TEXTURE_2D, &material.names[run.offset]);
+		if (state.shininess >= 0 && !(state.hasShininess && state.shininessValue == material.shininess))
+		{
+			glUniform1f(state.shininess, material.shininess);
+			state.shininessValue = material.shininess;
+			state.hasShininess = true;
+		}
+		state.lastMaterial = handle.index;
+		state.textureChanges = glState().textureBindingChanges();
+	}
+
+	size_t size() const
+	{
+		return materials.size();
+	}
+
+private:
+	using TextureSlots = std::vector<std::pair<uint32_t, GLuint> >;   // (slot, texture), by slot
+	using Key = std::pair<TextureSlots, uint32_t>;
+
+	// consecutive units bound by one call
+	struct TextureRun
+	{
+		uint32_t first = 0;     // unit of the first texture
+		uint32_t count = 0;
+		uint32_t offset = 0;    // into Material::names
+	};
+
+	struct Material
+	{
+		TextureSlots textures;
+		float shininess = 32.0f;
+		std::vector<GLuint> names;      // the textures in slot order, for glBindTextures
+		std::vector<TextureRun> runs;
+	};
+
+	// what has been set up in one program
+	struct Program
+	{
+		GLuint program = 0;
+		uint32_t resolvedSlots = 0;     // slots whose sampler uniform has been pointed at its unit
+		GLint shininess = -1;
+		float shininessValue = 0.0f;    // what the uniform holds, once hasShininess is set
+		bool hasShininess = false;
+		uint32_t lastMaterial = UINT32_MAX;
+		unsigned int textureChanges = 0;    // glState().textureBindingChanges() right after lastMaterial was bound
+	};
+
+	std::vector<Material> materials;
+	std::map<Key, MaterialHandle> known;
+	std::vector<std::string> slotNames;     // the unit of a slot is its index
+	std::vector<Program> programs;
+	size_t lastProgram = 0;
+
+	uint32_t slotFor(const std::string& name)
+	{
+		for (uint32_t slot = 0; slot < (uint32_t)slotNames.size(); slot++)
+			if (slotNames[slot] == name)
+				return slot;
+		if (slotNames.size() >= MAX_MATERIAL_SLOTS)
+		{
+			std::cout << "ERROR::MATERIAL::TOO_MANY_SAMPLERS " << name << " needs more than " << MAX_MATERIAL_SLOTS << " texture units" << std::endl;
+			return MAX_MATERIAL_SLOTS;
+		}
+		slotNames.push_back(name);
+		return (uint32_t)slotNames.size() - 1;
+	}
+
+	// the program's state, with any sampler named since it was last seen pointed at its unit
+	Program& resolve(GLuint program)
+	{
+		if (lastProgram >= programs.size() || programs[lastProgram].program != program)
+		{
+			lastProgram = 0;
+			while (lastProgram < programs.size() && programs[lastProgram].program != program)
+				lastProgram++;
+			if (lastProgram == programs.size())
+			{
+				Program state;
+				state.program = program;
+				state.shininess = glGetUniformLocation(program, "material.shininess");
+				programs.push_back(state);
+			}
+		}
+		Program& state = programs[lastProgram];
+		for (; state.resolvedSlots < (uint32_t)slotNames.size(); state.resolvedSlots++)
+		{
+			GLint location = glGetUniformLocation(program, slotNames[state.resolvedSlots].c_str());
+			if (location >= 0)
+				glUniform1i(location, (GLint)state.resolvedSlots);
+		}
+		return state;
+	}
+};
+
+inline MaterialLibrary& materials()
+{
+	static MaterialLibrary library;
+	return library;
+}
+#endif
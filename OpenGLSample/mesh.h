@@ -7,8 +7,22 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.h"
+#include "dirty_ranges.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "material.h"
+#include "mesh_cpu_memory.h"
+#include "mesh_processing.h"
+#include "meshlet.h"
+#include "tangent_space.h"
+#include "vertex_format.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -25,10 +39,25 @@ struct Vertex {
 	glm::vec3 Bitangent;
 };
 
-struct Texture {
-	unsigned int id;
-	string type;
-	string path;
+// Vertex split in two streams: positions alone, so depth and shadow passes fetch 12 bytes a
+// vertex, and everything else for the shading passes
+using MeshPositionStream = VertexFormat<Position3f>;
+using MeshAttributeStream = VertexFormat<Normal3f, TexCoord2f, Tangent3f, Bitangent3f>;
+using MeshStreams = VertexStreams<MeshPositionStream, MeshAttributeStream>;
+static_assert(MeshAttributeStream::stride == sizeof(Vertex) - offsetof(Vertex, Normal), "attribute stream must match the tail of Vertex");
+// the same vertex interleaved, as the mesh pool and the mesh tools (simplification, LOD) take it
+using MeshVertexFormat = VertexFormat<Position3f, Normal3f, TexCoord2f, Tangent3f, Bitangent3f>;
+static_assert(MeshVertexFormat::stride == sizeof(Vertex), "interleaved format must match Vertex");
+
+// edits closer than this many vertices (or indices) are uploaded together, the clean ones between included
+const size_t MESH_EDIT_MERGE_GAP = 32;
+
+// what a Mesh keeps on the CPU once its buffers are filled
+enum class MeshCpuData
+{
+	Keep,       // vertices and indices, for edits (uploadEdits) and the mesh tools (indexedMesh)
+	Release,    // nothing; the mesh can only be drawn
+	Shadow,     // positions and indices only, for picking and physics
 };
 
 class Mesh {
@@ -38,97 +67,276 @@ public:
 	vector<unsigned int> indices;
 	vector<Texture>      textures;
 	unsigned int VAO;
+	unsigned int depthVAO; // position stream only
+	vector<Meshlet>      meshlets; // contiguous ranges of indices, for DrawVisible
+	MaterialHandle       material; // the textures, resolved once in materials()
+	MeshCpuData          cpuData;
+	vector<glm::vec3>    shadowPositions; // MeshCpuData::Shadow only; indices stay in `indices`
 
-	// constructor
-	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+	// constructor; pass the vectors with std::move to hand them over without a copy
+	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, MeshCpuData cpuData = MeshCpuData::Keep)
+		: vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), cpuData(cpuData)
 	{
-		this->vertices = vertices;
-		this->indices = indices;
-		this->textures = textures;
+		// files without tangents get MikkTSpace-style ones, so normal maps work either way
+		if (!hasTangents())
+			computeTangents();
 
 		// now that we have all the required data, set the vertex buffers and its attribute pointers.
 		setupMesh();
+		dropCpuData();
+		material = materials().add(this->textures);
 	}
 
-	// render the mesh
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&&) = default;
+	Mesh& operator=(Mesh&&) = default;
+
+	// render the mesh; the shader must be in use
 	void Draw(Shader &shader)
 	{
-		// bind appropriate textures
-		unsigned int diffuseNr = 1;
-		unsigned int specularNr = 1;
-		unsigned int normalNr = 1;
-		unsigned int heightNr = 1;
-		for (unsigned int i = 0; i < textures.size(); i++)
+		materials().bind(material, shader.ID);
+
+		// draw mesh; bindings are left in place, the state cache skips them if the next draw matches
+		glState().bindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+	}
+
+	// render only the meshlets inside the frustum and facing the camera, drawn with `model`
+	void DrawVisible(Shader &shader, const glm::mat4& model, const MeshletView& view)
+	{
+		visible.clear();
+		cullMeshlets(meshlets, model, view, nullptr, sizeof(unsigned int), visible);
+		if (visible.counts.empty())
+			return;
+
+		materials().bind(material, shader.ID);
+		glState().bindVertexArray(VAO);
+		glMultiDrawElements(GL_TRIANGLES, visible.counts.data(), GL_UNSIGNED_INT, visible.offsets.data(), (GLsizei)visible.counts.size());
+	}
+
+	// the mesh as interleaved floats, e.g. for prepareSimplifiedChain (mesh_simplify.h); needs MeshCpuData::Keep
+	IndexedMesh indexedMesh() const
+	{
+		IndexedMesh mesh;
+		mesh.floatsPerVertex = sizeof(Vertex) / sizeof(float);
+		mesh.vertices.resize(vertices.size() * mesh.floatsPerVertex);
+		if (!vertices.empty())
+			memcpy(mesh.vertices.data(), vertices.data(), vertices.size() * sizeof(Vertex));
+		mesh.indices.assign(indices.begin(), indices.end());
+		return mesh;
+	}
+
+	// render positions only, for depth and shadow passes
+	void DrawDepth()
+	{
+		glState().bindVertexArray(depthVAO);
+		glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+	}
+
+	// Edits: change vertices or indices in place (same counts), report what changed here, and
+	// uploadEdits() sends only those ranges instead of the whole mesh
+	void verticesChanged(size_t first, size_t count)
+	{
+		if (editable())
+			dirtyVertices.mark(first, count);
+	}
+
+	void indicesChanged(size_t first, size_t count)
+	{
+		if (editable())
+			dirtyIndices.mark(first, count);
+	}
+
+	// uploads the edits reported since the last call, one glBufferSubData per merged range and
+	// stream, and refits the bounds of the meshlets the edits reach; returns the bytes sent
+	size_t uploadEdits()
+	{
+		if (dirtyVertices.empty() && dirtyIndices.empty())
+			return 0;
+		refitEditedMeshlets();
+		size_t bytes = 0;
+		vector<unsigned char> staging;
+		dirtyVertices.flush([&](size_t first, size_t count)
+		{
+			// each range goes to both streams, split the way setupMesh split the whole mesh
+			staging.resize(count * MeshAttributeStream::stride);
+			for (size_t i = 0; i < count; i++)
+				memcpy(&staging[i * sizeof(glm::vec3)], &vertices[first + i].Position, sizeof(glm::vec3));
+			bytes += uploadRange(positionBuffer.id(), first * sizeof(glm::vec3), count * sizeof(glm::vec3), staging.data());
+			for (size_t i = 0; i < count; i++)
+				memcpy(&staging[i * MeshAttributeStream::stride], &vertices[first + i].Normal, MeshAttributeStream::stride);
+			bytes += uploadRange(attributeBuffer.id(), first * MeshAttributeStream::stride, count * MeshAttributeStream::stride, staging.data());
+		});
+		dirtyIndices.flush([&](size_t first, size_t count)
 		{
-			glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-			// retrieve texture number (the N in diffuse_textureN)
-			string number;
-			string name = textures[i].type;
-			if (name == "texture_diffuse")
-				number = std::to_string(diffuseNr++);
-			else if (name == "texture_specular")
-				number = std::to_string(specularNr++); // transfer unsigned int to stream
-			else if (name == "texture_normal")
-				number = std::to_string(normalNr++); // transfer unsigned int to stream
-			else if (name == "texture_height")
-				number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-			// now set the sampler to the correct texture unit
-			glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-			// and finally bind the texture
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+			bytes += uploadRange(indexBuffer.id(), first * sizeof(unsigned int), count * sizeof(unsigned int), &indices[first]);
+		});
+		return bytes;
+	}
+
+private:
+	// render data, deleted through the registry with the mesh
+	GpuResource vertexArray, depthVertexArray, positionBuffer, attributeBuffer, indexBuffer;
+	GLsizei indexCount = 0;
+	MeshCpuAccount cpuAccount;
+	// ranges that survived the last DrawVisible
+	MeshletDrawList visible;
+	// edited since the last uploadEdits, in vertices and in indices
+	DirtyRanges dirtyVertices = DirtyRanges(MESH_EDIT_MERGE_GAP);
+	DirtyRanges dirtyIndices = DirtyRanges(MESH_EDIT_MERGE_GAP);
+	// lowest and highest vertex each meshlet uses, to find the meshlets a vertex edit reaches
+	vector<std::pair<uint32_t, uint32_t> > meshletVertexSpans;
+
+	// true if any of the sorted, disjoint ranges overlaps [begin, end)
+	static bool overlapsAny(const vector<DirtyRanges::Range>& ranges, size_t begin, size_t end)
+	{
+		auto range = std::lower_bound(ranges.begin(), ranges.end(), begin,
+			[](const DirtyRanges::Range& r, size_t value) { return r.end <= value; });
+		return range != ranges.end() && range->begin < end;
+	}
+
+	std::pair<uint32_t, uint32_t> vertexSpan(const Meshlet& meshlet) const
+	{
+		std::pair<uint32_t, uint32_t> span(UINT32_MAX, 0);
+		for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++)
+		{
+			span.first = std::min(span.first, indices[i]);
+			span.second = std::max(span.second, indices[i]);
 		}
+		return span;
+	}
 
-		// draw mesh
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
+	void spanMeshlets()
+	{
+		meshletVertexSpans.resize(meshlets.size());
+		for (size_t m = 0; m < meshlets.size(); m++)
+			meshletVertexSpans[m] = vertexSpan(meshlets[m]);
+	}
 
-		// always good practice to set everything back to defaults once configured.
-		glActiveTexture(GL_TEXTURE0);
+	// CPU only: the meshlet ranges themselves never change, so only the spheres and cones of the
+	// meshlets an edit reaches move. An index edit reaches the meshlets whose index range it
+	// overlaps; a vertex edit those whose vertex span it overlaps, which may include a meshlet
+	// that only spans the vertex but never one that uses it. Costs a check per meshlet plus a
+	// refit of the ones reached, not a pass over the whole mesh.
+	void refitEditedMeshlets()
+	{
+		// meshlets replaced since setupMesh
+		if (meshletVertexSpans.size() != meshlets.size())
+			spanMeshlets();
+		for (size_t m = 0; m < meshlets.size(); m++)
+		{
+			Meshlet& meshlet = meshlets[m];
+			const std::pair<uint32_t, uint32_t>& span = meshletVertexSpans[m];
+			bool indicesEdited = overlapsAny(dirtyIndices.list(), meshlet.firstIndex, (size_t)meshlet.firstIndex + meshlet.indexCount);
+			bool verticesEdited = meshlet.indexCount > 0 && overlapsAny(dirtyVertices.list(), span.first, (size_t)span.second + 1);
+			if (!indicesEdited && !verticesEdited)
+				continue;
+			updateMeshletBounds(meshlet, indices.data(), [this](uint32_t v) { return vertices[v].Position; });
+			if (indicesEdited)
+				meshletVertexSpans[m] = vertexSpan(meshlet);
+		}
 	}
 
-private:
-	// render data 
-	unsigned int VBO, EBO;
+	size_t uploadRange(GLuint buffer, size_t offset, size_t size, const void* data)
+	{
+		glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)offset, (GLsizeiptr)size, data);
+		glState().bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return size;
+	}
+
+	bool editable() const
+	{
+		if (cpuData == MeshCpuData::Keep)
+			return true;
+		std::cout << "ERROR::MESH::CPU_DATA_RELEASED edits need MeshCpuData::Keep" << std::endl;
+		return false;
+	}
+
+	// frees what the ownership mode does not keep, then books what is left in meshCpuMemory()
+	void dropCpuData()
+	{
+		indexCount = (GLsizei)indices.size();
+		if (cpuData == MeshCpuData::Shadow)
+		{
+			shadowPositions.resize(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+				shadowPositions[i] = vertices[i].Position;
+		}
+		if (cpuData != MeshCpuData::Keep)
+			vector<Vertex>().swap(vertices);
+		if (cpuData == MeshCpuData::Release)
+			vector<unsigned int>().swap(indices);
+		cpuAccount.set(vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int)
+			+ shadowPositions.capacity() * sizeof(glm::vec3) + meshlets.capacity() * sizeof(Meshlet)
+			+ meshletVertexSpans.capacity() * sizeof(std::pair<uint32_t, uint32_t>));
+	}
+
+	bool hasTangents() const
+	{
+		for (const Vertex& vertex : vertices)
+			if (vertex.Tangent != glm::vec3(0.0f))
+				return true;
+		return false;
+	}
+
+	// fills Tangent and Bitangent; vertices shared across a UV mirror are split, so the counts may grow
+	void computeTangents()
+	{
+		IndexedMesh mesh = indexedMesh();
+		generateTangents(mesh);
+		vertices.resize(mesh.vertexCount());
+		if (!vertices.empty())
+			memcpy(static_cast<void*>(vertices.data()), mesh.vertices.data(), vertices.size() * sizeof(Vertex));
+		indices.assign(mesh.indices.begin(), mesh.indices.end());
+	}
 
 	// initializes all the buffer objects/arrays
 	void setupMesh()
 	{
-		// create buffers/arrays
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
-		glGenBuffers(1, &EBO);
-
-		glBindVertexArray(VAO);
-		// load data into vertex buffers
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		// A great thing about structs is that their memory layout is sequential for all its items.
-		// The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-		// again translates to 3/2 floats which translates to a byte array.
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-		// set the vertex attribute pointers
-		// vertex Positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-		// vertex normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-		// vertex texture coords
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-		// vertex tangent
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-		// vertex bitangent
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-		glBindVertexArray(0);
+		// split the vertices into the two streams; the attribute stream is the tail of each Vertex
+		vector<glm::vec3> positions(vertices.size());
+		vector<unsigned char> attributes(vertices.size() * MeshAttributeStream::stride);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			positions[i] = vertices[i].Position;
+			memcpy(&attributes[i * MeshAttributeStream::stride], &vertices[i].Normal, MeshAttributeStream::stride);
+		}
+
+		// cut into meshlets over the positions; this reorders the indices so each meshlet is one range
+		IndexedMesh clusters;
+		clusters.floatsPerVertex = 3;
+		clusters.vertices.resize(positions.size() * 3);
+		if (!positions.empty())
+			memcpy(clusters.vertices.data(), positions.data(), positions.size() * sizeof(glm::vec3));
+		clusters.indices.assign(indices.begin(), indices.end());
+		meshlets = buildMeshlets(clusters);
+		indices.assign(clusters.indices.begin(), clusters.indices.end());
+		// only meshes that keep their data can be edited
+		if (cpuData == MeshCpuData::Keep)
+			spanMeshlets();
+
+		// create buffers with immutable storage; their contents change only through uploadEdits
+		positionBuffer = makeBuffer(MemoryCategory::Vertex, positions.size() * sizeof(glm::vec3), &positions[0], GL_DYNAMIC_STORAGE_BIT);
+		attributeBuffer = makeBuffer(MemoryCategory::Vertex, attributes.size(), &attributes[0], GL_DYNAMIC_STORAGE_BIT);
+		indexBuffer = makeBuffer(MemoryCategory::Index, indices.size() * sizeof(unsigned int), &indices[0], GL_DYNAMIC_STORAGE_BIT);
+		GLuint streams[MeshStreams::count] = { positionBuffer.id(), attributeBuffer.id() };
+
+		// the attribute pointers come from the stream formats
+		vertexArray = makeVertexArray();
+		VAO = vertexArray.id();
+		glState().bindVertexArray(VAO);
+		glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.id());
+		MeshStreams::setup(streams);
+
+		depthVertexArray = makeVertexArray();
+		depthVAO = depthVertexArray.id();
+		glState().bindVertexArray(depthVAO);
+		glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.id());
+		MeshStreams::setupFirst(streams, 1);
+
+		glState().bindVertexArray(0);
 	}
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,86 @@
+#ifndef MESH_CPU_MEMORY_H
+#define MESH_CPU_MEMORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+// CPU bytes every live mesh.h Mesh still holds after upload, across the process
+struct MeshCpuMemory
+{
+	std::atomic<int64_t> meshes{ 0 };
+	std::atomic<int64_t> bytes{ 0 };
+
+	void report(std::ostream& out) const
+	{
+		out << "Mesh CPU memory: " << bytes.load() << " bytes held by " << meshes.load() << " meshes" << std::endl;
+	}
+};
+
+inline MeshCpuMemory& meshCpuMemory()
+{
+	static MeshCpuMemory memory;
+	return memory;
+}
+
+// one mesh's entry in meshCpuMemory(); moves with the mesh and is withdrawn when it goes
+class MeshCpuAccount
+{
+public:
+	MeshCpuAccount()
+		: held(0), live(true)
+	{
+		meshCpuMemory().meshes++;
+	}
+
+	~MeshCpuAccount()
+	{
+		withdraw();
+	}
+
+	MeshCpuAccount(const MeshCpuAccount&) = delete;
+	MeshCpuAccount& operator=(const MeshCpuAccount&) = delete;
+
+	MeshCpuAccount(MeshCpuAccount&& other) noexcept
+		: held(other.held), live(other.live)
+	{
+		other.held = 0;
+		other.live = false;
+	}
+
+	MeshCpuAccount& operator=(MeshCpuAccount&& other) noexcept
+	{
+		if (this != &other)
+		{
+			withdraw();
+			held = other.held;
+			live = other.live;
+			other.held = 0;
+			other.live = false;
+		}
+		return *this;
+	}
+
+	// the bytes the mesh holds now
+	void set(size_t bytes)
+	{
+		meshCpuMemory().bytes += (int64_t)bytes - (int64_t)held;
+		held = bytes;
+	}
+
+private:
+	size_t held;
+	bool live;
+
+	void withdraw()
+	{
+		if (!live)
+			return;
+		meshCpuMemory().meshes--;
+		meshCpuMemory().bytes -= (int64_t)held;
+		held = 0;
+		live = false;
+	}
+};
+#endif
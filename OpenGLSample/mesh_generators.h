@@ -0,0 +1,556 @@
+#ifndef MESH_GENERATORS_H
+#define MESH_GENERATORS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESH_GENERATORS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Parametric mesh generators: frustum (and cylinder), torus, sphere, capsule, box and plane.
+// Each shape reports its exact vertex and index counts up front and then writes straight into
+// memory the caller provides, either its own or a MeshArena reused from mesh to mesh, so there
+// is no allocation per mesh. Vertices are 8 floats, position, normal and UV, the layout of the
+// procedural meshes in Source.cpp; indices are counter-clockwise seen from outside.
+//
+// The round shapes are lathes: a profile curve in (radius, y) swept around the y axis. The sines
+// and cosines of the sweep come from one table per mesh, filled four angles at a time, and the
+// rows of the sweep are written in parallel once a mesh is large enough to pay for the threads.
+
+const uint32_t GENERATOR_FLOATS_PER_VERTEX = 8;
+// meshes with at least this many vertices are generated on several threads
+const uint32_t PARALLEL_GENERATION_VERTICES = 1 << 16;
+
+struct MeshCounts
+{
+	uint32_t vertices = 0;
+	uint32_t indices = 0;
+};
+
+// where a generator writes; both arrays must hold the shape's MeshCounts
+struct MeshOutput
+{
+	float* vertices = nullptr;
+	uint32_t* indices = nullptr;
+};
+
+// Scratch memory for generator output. allocate() only grows the buffers, so once the largest
+// mesh has been generated further meshes reuse the same memory.
+class MeshArena
+{
+public:
+	MeshOutput allocate(const MeshCounts& counts)
+	{
+		if (vertices.size() < (size_t)counts.vertices * GENERATOR_FLOATS_PER_VERTEX)
+			vertices.resize((size_t)counts.vertices * GENERATOR_FLOATS_PER_VERTEX);
+		if (indices.size() < counts.indices)
+			indices.resize(counts.indices);
+		MeshOutput output;
+		output.vertices = vertices.data();
+		output.indices = indices.data();
+		return output;
+	}
+
+	size_t capacityBytes() const
+	{
+		return vertices.capacity() * sizeof(float) + indices.capacity() * sizeof(uint32_t);
+	}
+
+private:
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+};
+
+// ---------------------------------------------------------------------------------------------
+// sine and cosine tables
+
+// Cephes single-precision polynomials on [-pi/4, pi/4], after reducing by quadrant; the scalar
+// and SSE2 paths compute the same thing, so a table does not depend on where its tail falls
+const float SINCOS_TWO_OVER_PI = 0.636619772f;
+const float SINCOS_PI_OVER_TWO_HIGH = 1.5703125f;
+const float SINCOS_PI_OVER_TWO_LOW = 4.83826794897e-4f;
+
+inline void sinCos(float angle, float& sine, float& cosine)
+{
+	float quadrant = std::nearbyint(angle * SINCOS_TWO_OVER_PI);
+	float r = (angle - quadrant * SINCOS_PI_OVER_TWO_HIGH) - quadrant * SINCOS_PI_OVER_TWO_LOW;
+	float z = r * r;
+	float s = r + r * z * (-1.6666654611e-1f + z * (8.3321608736e-3f + z * -1.9515295891e-4f));
+	float c = 1.0f - 0.5f * z + z * z * (4.166664568298827e-2f + z * (-1.388731625493765e-3f + z * 2.443315711809948e-5f));
+	switch ((int)quadrant & 3)
+	{
+	case 0: sine = s; cosine = c; break;
+	case 1: sine = c; cosine = -s; break;
+	case 2: sine = -s; cosine = -c; break;
+	default: sine = -c; cosine = s; break;
+	}
+}
+
+#ifdef MESH_GENERATORS_SSE2
+inline void sinCos4(__m128 angle, __m128& sine, __m128& cosine)
+{
+	__m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(SINCOS_TWO_OVER_PI)));
+	__m128 q = _mm_cvtepi32_ps(quadrant);
+	__m128 r = _mm_sub_ps(_mm_sub_ps(angle, _mm_mul_ps(q, _mm_set1_ps(SINCOS_PI_OVER_TWO_HIGH))), _mm_mul_ps(q, _mm_set1_ps(SINCOS_PI_OVER_TWO_LOW)));
+	__m128 z = _mm_mul_ps(r, r);
+
+	__m128 s = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(-1.9515295891e-4f)), _mm_set1_ps(8.3321608736e-3f));
+	s = _mm_add_ps(_mm_mul_ps(z, s), _mm_set1_ps(-1.6666654611e-1f));
+	s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z), s));
+	__m128 c = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(2.443315711809948e-5f)), _mm_set1_ps(-1.388731625493765e-3f));
+	c = _mm_add_ps(_mm_mul_ps(z, c), _mm_set1_ps(4.166664568298827e-2f));
+	c = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_mul_ps(_mm_mul_ps(z, z), c));
+
+	// odd quadrants swap sine and cosine; the sign bits come from bit 1 of q and of q + 1
+	__m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+	__m128 sineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+	__m128 cosineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30));
+	sine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s)), sineSign);
+	cosine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c)), cosineSign);
+}
+#endif
+
+// sines and cosines of start + i * step for i in [0, count)
+inline void sinCosTable(float start, float step, uint32_t count, float* sines, float* cosines)
+{
+	uint32_t i = 0;
+#ifdef MESH_GENERATORS_SSE2
+	__m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 angle = _mm_add_ps(_mm_set1_ps(start), _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)i), lanes), _mm_set1_ps(step)));
+		__m128 sine, cosine;
+		sinCos4(angle, sine, cosine);
+		_mm_storeu_ps(sines + i, sine);
+		_mm_storeu_ps(cosines + i, cosine);
+	}
+#endif
+	for (; i < count; i++)
+		sinCos(start + (float)i * step, sines[i], cosines[i]);
+}
+
+// the segments + 1 directions of a full turn; the last repeats the first exactly, so the seam closes
+struct TurnTable
+{
+	std::vector<float> sines, cosines;
+
+	explicit TurnTable(int segments)
+		: sines(segments + 1), cosines(segments + 1)
+	{
+		sinCosTable(0.0f, 6.28318531f / (float)segments, (uint32_t)segments, sines.data(), cosines.data());
+		sines[segments] = sines[0];
+		cosines[segments] = cosines[0];
+	}
+};
+
+// ---------------------------------------------------------------------------------------------
+// parallel rows
+
+// calls rows(first, end) over [0, count), on several threads when there are enough vertices
+template <typename Rows>
+inline void forEachRowRange(uint32_t count, uint32_t verticesPerRow, Rows rows)
+{
+	unsigned int workers = 1;
+	if ((uint64_t)count * verticesPerRow >= PARALLEL_GENERATION_VERTICES)
+		workers = std::max(1u, std::min(std::thread::hardware_concurrency(), count));
+	if (workers <= 1)
+	{
+		rows(0u, count);
+		return;
+	}
+
+	uint32_t chunk = (count + workers - 1) / workers;
+	std::vector<std::thread> threads;
+	for (uint32_t first = chunk; first < count; first += chunk)
+		threads.emplace_back(rows, first, std::min(count, first + chunk));
+	rows(0u, std::min(count, chunk));
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+// ---------------------------------------------------------------------------------------------
+// lathes
+
+// one point of a lathe profile: distance from the axis, height, the outward normal in the same
+// plane and the texture v; a point on the axis (radius 0) is a pole
+struct ProfilePoint
+{
+	float radius;
+	float y;
+	float normalRadius;
+	float normalY;
+	float v;
+};
+
+inline bool isPole(const ProfilePoint& point)
+{
+	return point.radius == 0.0f;
+}
+
+// indices of one row of quads between two neighbouring directions; quads touching a pole lose
+// the triangle that would have no area
+inline uint32_t latheRowIndices(const std::vector<ProfilePoint>& profile)
+{
+	uint32_t count = 0;
+	for (size_t c = 0; c + 1 < profile.size(); c++)
+		count += (isPole(profile[c]) ? 0 : 3) + (isPole(profile[c + 1]) ? 0 : 3);
+	return count;
+}
+
+inline MeshCounts latheCounts(const std::vector<ProfilePoint>& profile, int segments)
+{
+	MeshCounts counts;
+	counts.vertices = (uint32_t)(segments + 1) * (uint32_t)profile.size();
+	counts.indices = (uint32_t)segments * latheRowIndices(profile);
+	return counts;
+}
+
+// sweeps the profile (bottom to top) around the y axis; vertex indices start at baseVertex
+inline void generateLathe(const std::vector<ProfilePoint>& profile, int segments, MeshOutput out, uint32_t baseVertex = 0)
+{
+	TurnTable turn(segments);
+	uint32_t columns = (uint32_t)profile.size();
+	uint32_t rowIndices = latheRowIndices(profile);
+
+	forEachRowRange((uint32_t)segments + 1, columns, [&](uint32_t first, uint32_t end)
+	{
+		for (uint32_t r = first; r < end; r++)
+		{
+			float cosine = turn.cosines[r], sine = turn.sines[r];
+			float u = (float)r / (float)segments;
+			float* vertex = out.vertices + (size_t)r * columns * GENERATOR_FLOATS_PER_VERTEX;
+			for (const ProfilePoint& point : profile)
+			{
+				vertex[0] = point.radius * cosine;
+				vertex[1] = point.y;
+				vertex[2] = point.radius * sine;
+				vertex[3] = point.normalRadius * cosine;
+				vertex[4] = point.normalY;
+				vertex[5] = point.normalRadius * sine;
+				vertex[6] = u;
+				vertex[7] = point.v;
+				vertex += GENERATOR_FLOATS_PER_VERTEX;
+			}
+
+			if (r == (uint32_t)segments)
+				continue;
+			uint32_t* index = out.indices + (size_t)r * rowIndices;
+			uint32_t row = baseVertex + r * columns, next = row + columns;
+			for (uint32_t c = 0; c + 1 < columns; c++)
+			{
+				if (!isPole(profile[c]))
+				{
+					*index++ = row + c;
+					*index++ = row + c + 1;
+					*index++ = next + c;
+				}
+				if (!isPole(profile[c + 1]))
+				{
+					*index++ = next + c;
+					*index++ = row + c + 1;
+					*index++ = next + c + 1;
+				}
+			}
+		}
+	});
+}
+
+// a flat cap at height y facing up (normalY 1) or down (-1): a centre and a ring of segments + 1
+inline MeshCounts discCounts(int segments)
+{
+	MeshCounts counts;
+	counts.vertices = (uint32_t)segments + 2;
+	counts.indices = (uint32_t)segments * 3;
+	return counts;
+}
+
+inline void generateDisc(float y, float radius, float normalY, int segments, MeshOutput out, uint32_t baseVertex)
+{
+	TurnTable turn(segments);
+	float* vertex = out.vertices;
+	const float centre[GENERATOR_FLOATS_PER_VERTEX] = { 0.0f, y, 0.0f, 0.0f, normalY, 0.0f, 0.5f, 0.5f };
+	std::copy(centre, centre + GENERATOR_FLOATS_PER_VERTEX, vertex);
+	vertex += GENERATOR_FLOATS_PER_VERTEX;
+	for (int i = 0; i <= segments; i++)
+	{
+		vertex[0] = radius * turn.cosines[i];
+		vertex[1] = y;
+		vertex[2] = radius * turn.sines[i];
+		vertex[3] = 0.0f;
+		vertex[4] = normalY;
+		vertex[5] = 0.0f;
+		vertex[6] = 0.5f + 0.5f * turn.cosines[i];
+		vertex[7] = 0.5f + 0.5f * turn.sines[i];
+		vertex += GENERATOR_FLOATS_PER_VERTEX;
+	}
+
+	uint32_t* index = out.indices;
+	for (int i = 0; i < segments; i++)
+	{
+		uint32_t ring = baseVertex + 1 + (uint32_t)i;
+		*index++ = baseVertex;
+		*index++ = normalY < 0.0f ? ring : ring + 1;
+		*index++ = normalY < 0.0f ? ring + 1 : ring;
+	}
+}
+
+// ---------------------------------------------------------------------------------------------
+// shapes
+
+// a cone frustum standing on the xz plane's origin, capped at both ends; equal radii give a cylinder
+struct FrustumShape
+{
+	float bottomRadius = 0.5f;
+	float topRadius = 0.5f;
+	float height = 1.0f;    // centred on y = 0
+	int segments = 32;
+	bool caps = true;
+};
+
+inline std::vector<ProfilePoint> frustumProfile(const FrustumShape& shape)
+{
+	// the side's normal leans by the slope, so a cone is shaded as a cone
+	float slope = shape.bottomRadius - shape.topRadius;
+	float length = std::sqrt(shape.height * shape.height + slope * slope);
+	float normalRadius = shape.height / length, normalY = slope / length;
+	return {
+		{ shape.bottomRadius, -shape.height * 0.5f, normalRadius, normalY, 0.0f },
+		{ shape.topRadius, shape.height * 0.5f, normalRadius, normalY, 1.0f },
+	};
+}
+
+inline MeshCounts frustumCounts(const FrustumShape& shape)
+{
+	MeshCounts counts = latheCounts(frustumProfile(shape), shape.segments);
+	if (shape.caps)
+	{
+		counts.vertices += discCounts(shape.segments).vertices * 2;
+		counts.indices += discCounts(shape.segments).indices * 2;
+	}
+	return counts;
+}
+
+inline void generateFrustum(const FrustumShape& shape, MeshOutput out)
+{
+	std::vector<ProfilePoint> profile = frustumProfile(shape);
+	generateLathe(profile, shape.segments, out);
+	if (!shape.caps)
+		return;
+
+	MeshCounts side = latheCounts(profile, shape.segments), disc = discCounts(shape.segments);
+	MeshOutput bottom = { out.vertices + (size_t)side.vertices * GENERATOR_FLOATS_PER_VERTEX, out.indices + side.indices };
+	generateDisc(-shape.height * 0.5f, shape.bottomRadius, -1.0f, shape.segments, bottom, side.vertices);
+	MeshOutput top = { bottom.vertices + (size_t)disc.vertices * GENERATOR_FLOATS_PER_VERTEX, bottom.indices + disc.indices };
+	generateDisc(shape.height * 0.5f, shape.topRadius, 1.0f, shape.segments, top, side.vertices + disc.vertices);
+}
+
+// a ring around the y axis in the xz plane
+struct TorusShape
+{
+	float ringRadius = 0.4f;    // axis to tube centre
+	float tubeRadius = 0.05f;
+	int ringSegments = 48;
+	int tubeSegments = 16;
+};
+
+inline std::vector<ProfilePoint> torusProfile(const TorusShape& shape)
+{
+	TurnTable tube(shape.tubeSegments);
+	std::vector<ProfilePoint> profile(shape.tubeSegments + 1);
+	for (int j = 0; j <= shape.tubeSegments; j++)
+	{
+		float cosine = tube.cosines[j], sine = tube.sines[j];
+		profile[j] = { shape.ringRadius + shape.tubeRadius * cosine, shape.tubeRadius * sine, cosine, sine, (float)j / (float)shape.tubeSegments };
+	}
+	return profile;
+}
+
+inline MeshCounts torusCounts(const TorusShape& shape)
+{
+	return latheCounts(torusProfile(shape), shape.ringSegments);
+}
+
+inline void generateTorus(const TorusShape& shape, MeshOutput out)
+{
+	generateLathe(torusProfile(shape), shape.ringSegments, out);
+}
+
+// a UV sphere around the origin
+struct SphereShape
+{
+	float radius = 0.5f;
+	int segments = 32;      // around the y axis
+	int rings = 16;         // pole to pole
+};
+
+// points of an arc from latitude `from` to `to` (radians) of a sphere centred at height y
+inline void appendArc(std::vector<ProfilePoint>& profile, float radius, float y, float from, float to, int steps, float v0, float v1)
+{
+	std::vector<float> sines(steps + 1), cosines(steps + 1);
+	sinCosTable(from, (to - from) / (float)steps, (uint32_t)steps + 1, sines.data(), cosines.data());
+	for (int k = 0; k <= steps; k++)
+	{
+		float t = (float)k / (float)steps;
+		float cosine = cosines[k], sine = sines[k];
+		// the poles sit exactly on the axis
+		if ((k == 0 && from <= -1.57079632f) || (k == steps && to >= 1.57079632f))
+		{
+			cosine = 0.0f;
+			sine = k == 0 ? -1.0f : 1.0f;
+		}
+		profile.push_back({ radius * cosine, y + radius * sine, cosine, sine, v0 + (v1 - v0) * t });
+	}
+}
+
+inline std::vector<ProfilePoint> sphereProfile(const SphereShape& shape)
+{
+	std::vector<ProfilePoint> profile;
+	appendArc(profile, shape.radius, 0.0f, -1.57079632f, 1.57079632f, shape.rings, 0.0f, 1.0f);
+	return profile;
+}
+
+inline MeshCounts sphereCounts(const SphereShape& shape)
+{
+	return latheCounts(sphereProfile(shape), shape.segments);
+}
+
+inline void generateSphere(const SphereShape& shape, MeshOutput out)
+{
+	generateLathe(sphereProfile(shape), shape.segments, out);
+}
+
+// a cylinder of the given height with a hemisphere on each end, along the y axis
+struct CapsuleShape
+{
+	float radius = 0.25f;
+	float height = 0.5f;    // of the cylinder between the hemispheres
+	int segments = 32;
+	int rings = 8;          // per hemisphere
+};
+
+inline std::vector<ProfilePoint> capsuleProfile(const CapsuleShape& shape)
+{
+	// v runs along the full length, so the texture does not stretch over the cylinder
+	float length = shape.height + 3.14159265f * shape.radius;
+	float quarter = 1.57079632f * shape.radius / length;
+	std::vector<ProfilePoint> profile;
+	appendArc(profile, shape.radius, -shape.height * 0.5f, -1.57079632f, 0.0f, shape.rings, 0.0f, quarter);
+	appendArc(profile, shape.radius, shape.height * 0.5f, 0.0f, 1.57079632f, shape.rings, 1.0f - quarter, 1.0f);
+	return profile;
+}
+
+inline MeshCounts capsuleCounts(const CapsuleShape& shape)
+{
+	return latheCounts(capsuleProfile(shape), shape.segments);
+}
+
+inline void generateCapsule(const CapsuleShape& shape, MeshOutput out)
+{
+	generateLathe(capsuleProfile(shape), shape.segments, out);
+}
+
+// an axis-aligned box around the origin, four vertices a face for flat normals
+struct BoxShape
+{
+	float width = 1.0f;
+	float height = 1.0f;
+	float depth = 1.0f;
+};
+
+inline MeshCounts boxCounts(const BoxShape&)
+{
+	MeshCounts counts;
+	counts.vertices = 24;
+	counts.indices = 36;
+	return counts;
+}
+
+inline void generateBox(const BoxShape& shape, MeshOutput out)
+{
+	// per face: normal, then the u and v axes with u x v = normal
+	static const float faces[6][9] = {
+		{ 1, 0, 0,   0, 0, -1,   0, 1, 0 },
+		{ -1, 0, 0,  0, 0, 1,    0, 1, 0 },
+		{ 0, 1, 0,   1, 0, 0,    0, 0, -1 },
+		{ 0, -1, 0,  1, 0, 0,    0, 0, 1 },
+		{ 0, 0, 1,   1, 0, 0,    0, 1, 0 },
+		{ 0, 0, -1,  -1, 0, 0,   0, 1, 0 },
+	};
+	static const float corners[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+	float half[3] = { shape.width * 0.5f, shape.height * 0.5f, shape.depth * 0.5f };
+
+	float* vertex = out.vertices;
+	for (uint32_t f = 0; f < 6; f++)
+	{
+		const float* n = faces[f];
+		for (const float* corner : corners)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				vertex[a] = (n[a] + corner[0] * n[3 + a] + corner[1] * n[6 + a]) * half[a];
+				vertex[3 + a] = n[a];
+			}
+			vertex[6] = 0.5f + 0.5f * corner[0];
+			vertex[7] = 0.5f + 0.5f * corner[1];
+			vertex += GENERATOR_FLOATS_PER_VERTEX;
+		}
+		const uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+		for (uint32_t k = 0; k < 6; k++)
+			out.indices[f * 6 + k] = f * 4 + quad[k];
+	}
+}
+
+// a grid on the xz plane facing up, centred on the origin
+struct PlaneShape
+{
+	float width = 1.0f;     // along x
+	float depth = 1.0f;     // along z
+	int widthSegments = 1;
+	int depthSegments = 1;
+};
+
+inline MeshCounts planeCounts(const PlaneShape& shape)
+{
+	MeshCounts counts;
+	counts.vertices = (uint32_t)(shape.widthSegments + 1) * (uint32_t)(shape.depthSegments + 1);
+	counts.indices = (uint32_t)shape.widthSegments * (uint32_t)shape.depthSegments * 6;
+	return counts;
+}
+
+inline void generatePlane(const PlaneShape& shape, MeshOutput out)
+{
+	uint32_t columns = (uint32_t)shape.depthSegments + 1;
+	forEachRowRange((uint32_t)shape.widthSegments + 1, columns, [&](uint32_t first, uint32_t end)
+	{
+		for (uint32_t i = first; i < end; i++)
+		{
+			float u = (float)i / (float)shape.widthSegments;
+			float* vertex = out.vertices + (size_t)i * columns * GENERATOR_FLOATS_PER_VERTEX;
+			for (uint32_t k = 0; k < columns; k++)
+			{
+				float v = (float)k / (float)shape.depthSegments;
+				const float values[GENERATOR_FLOATS_PER_VERTEX] = { (u - 0.5f) * shape.width, 0.0f, (v - 0.5f) * shape.depth, 0.0f, 1.0f, 0.0f, u, v };
+				std::copy(values, values + GENERATOR_FLOATS_PER_VERTEX, vertex);
+				vertex += GENERATOR_FLOATS_PER_VERTEX;
+			}
+
+			if (i == (uint32_t)shape.widthSegments)
+				continue;
+			uint32_t* index = out.indices + (size_t)i * shape.depthSegments * 6;
+			uint32_t row = i * columns, next = row + columns;
+			for (uint32_t k = 0; k + 1 < columns; k++)
+			{
+				const uint32_t quad[6] = { row + k, row + k + 1, next + k, next + k, row + k + 1, next + k + 1 };
+				std::copy(quad, quad + 6, index);
+				index += 6;
+			}
+		}
+	});
+}
+#endif
@@ -0,0 +1,365 @@
+#ifndef MESH_POOL_H
+#define MESH_POOL_H
+
+#include <glad/glad.h>
+
+#include "buffer_slabs.h"
+#include "geometry_registry.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "mesh_processing.h"
+#include "vertex_format.h"
+#include "vertex_layout.h"
+#include "vertex_quantization.h"
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A mesh's place in the pool. Offsets are not stored: they are read back from the pool when
+// drawing, since compaction may move the ranges.
+struct PooledMesh
+{
+	SlabRange vertices;
+	SlabRange indices;          // not valid for unindexed meshes
+	GLuint vertexArray = 0;     // shared with every mesh of the same layout in the same slabs
+	GLsizei stride = 0;
+	GLsizei vertexCount = 0;
+	GLsizei indexCount = 0;
+	GLenum indexType = GL_UNSIGNED_INT; // the type argument of glDrawElements*
+	VertexDecode decode;        // hand to SceneBuffer::setVertexDecode for every object drawing the mesh
+};
+
+// A mesh made ready for MeshPool on any thread: both payloads in the bytes the pool stores (the
+// indices already narrowed) and hashed for the GeometryRegistry, so all the GL thread has left
+// to do is allocate and copy.
+struct PoolUpload
+{
+	VertexLayout layout;
+	std::vector<unsigned char> vertices;
+	std::vector<unsigned char> indices;     // empty for unindexed meshes
+	GLsizei vertexCount = 0;
+	GLsizei indexCount = 0;
+	GLenum indexType = GL_UNSIGNED_INT;
+	VertexDecode decode;
+	GeometryKey vertexKey;
+	GeometryKey indexKey;
+
+	uint32_t indexSize() const
+	{
+		return indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+	}
+};
+
+inline void hashPoolUpload(PoolUpload& upload)
+{
+	upload.vertexKey = geometryKeyOf(upload.vertices.data(), (uint32_t)upload.vertices.size(), (uint32_t)upload.layout.stride);
+	if (!upload.indices.empty())
+		upload.indexKey = geometryKeyOf(upload.indices.data(), (uint32_t)upload.indices.size(), upload.indexSize());
+}
+
+// the output of processMesh(), as float vertices with the index width it picked
+inline PoolUpload preparePoolUpload(const VertexLayout& layout, const IndexedMesh& processed)
+{
+	PoolUpload upload;
+	upload.layout = layout;
+	const unsigned char* bytes = (const unsigned char*)processed.vertices.data();
+	upload.vertices.assign(bytes, bytes + processed.vertices.size() * sizeof(float));
+	upload.vertexCount = (GLsizei)processed.vertexCount();
+	upload.indices = processed.packedIndices();
+	upload.indexCount = (GLsizei)processed.indices.size();
+	upload.indexType = processed.indexType();
+	hashPoolUpload(upload);
+	return upload;
+}
+
+// a packed mesh, its vertex bytes moved rather than copied; the layout and decode come with it
+inline PoolUpload preparePoolUpload(QuantizedMesh quantized)
+{
+	PoolUpload upload;
+	upload.layout = quantized.layout;
+	upload.vertices = std::move(quantized.vertices);
+	upload.vertexCount = (GLsizei)quantized.vertexCount;
+	upload.indices = packIndices(quantized.indices, quantized.indexType());
+	upload.indexCount = (GLsizei)quantized.indices.size();
+	upload.indexType = quantized.indexType();
+	upload.decode = quantized.decode;
+	hashPoolUpload(upload);
+	return upload;
+}
+
+// where place() put a prepared mesh, and which of its ranges are still to be written
+struct PoolPlacement
+{
+	PooledMesh mesh;
+	bool writeVertices = false;
+	bool writeIndices = false;
+};
+
+// Packs the vertices and indices of many meshes into shared slabs. Vertex ranges are aligned to
+// the vertex stride, so every mesh in a slab can be addressed by a base vertex and one VAO per
+// (layout, vertex slab, index slab) serves them all. Draw with baseVertex() / indexOffset().
+// Payloads go through a GeometryRegistry each, so identical vertex or index data is stored once.
+class MeshPool
+{
+public:
+	explicit MeshPool(uint32_t slabSize = 1024 * 1024)
+		: vertexSlabs(MemoryCategory::Vertex, slabSize, "mesh vertices"),
+		  indexSlabs(MemoryCategory::Index, slabSize, "mesh indices"),
+		  vertexGeometry(vertexSlabs), indexGeometry(indexSlabs)
+	{
+	}
+
+	MeshPool(const MeshPool&) = delete;
+	MeshPool& operator=(const MeshPool&) = delete;
+
+	// copies interleaved float vertices (and 32-bit indices, if any) into the pool
+	PooledMesh add(const VertexLayout& layout, const float* vertices, GLsizei vertexCount, const GLuint* indices = nullptr, GLsizei indexCount = 0)
+	{
+		return addRaw(layout, vertices, vertexCount, indices, indexCount, GL_UNSIGNED_INT);
+	}
+
+	// uploads the output of processMesh(), with the index width it picked
+	PooledMesh add(const VertexLayout& layout, const IndexedMesh& processed)
+	{
+		if (processed.floatsPerVertex * sizeof(float) != (size_t)layout.stride)
+		{
+			std::cout << "ERROR::MESH_POOL::LAYOUT_MISMATCH mesh has " << processed.floatsPerVertex * sizeof(float)
+				<< " byte vertices, layout stride is " << layout.stride << std::endl;
+			return PooledMesh();
+		}
+		std::vector<unsigned char> indices = processed.packedIndices();
+		return addRaw(layout, processed.vertices.data(), (GLsizei)processed.vertexCount(),
+			indices.empty() ? nullptr : indices.data(), (GLsizei)processed.indices.size(), processed.indexType());
+	}
+
+	// uploads a packed mesh; its layout and decode come with it
+	PooledMesh add(const QuantizedMesh& quantized)
+	{
+		std::vector<unsigned char> indices = packIndices(quantized.indices, quantized.indexType());
+		PooledMesh mesh = addRaw(quantized.layout, quantized.vertices.data(), (GLsizei)quantized.vertexCount,
+			indices.empty() ? nullptr : indices.data(), (GLsizei)quantized.indices.size(), quantized.indexType());
+		mesh.decode = quantized.decode;
+		return mesh;
+	}
+
+	// uploads a prepared mesh; nothing is hashed or converted here
+	PooledMesh add(const PoolUpload& upload)
+	{
+		return placeUpload(upload, true).mesh;
+	}
+
+	// Places a prepared mesh without writing it, so a large one can be written over several
+	// frames: the flagged ranges have to be filled through writeVertices / writeIndices before
+	// anything draws the mesh, then handed to publish(). Payloads already resident are shared
+	// and need no writes; the unwritten ranges are shared with nobody until published.
+	PoolPlacement place(const PoolUpload& upload)
+	{
+		return placeUpload(upload, false);
+	}
+
+	// writes size bytes at offset of a placed mesh's vertex or index range
+	void writeVertices(const PooledMesh& mesh, uint32_t offset, uint32_t size, const void* data)
+	{
+		vertexSlabs.upload(mesh.vertices, offset, size, data);
+	}
+
+	void writeIndices(const PooledMesh& mesh, uint32_t offset, uint32_t size, const void* data)
+	{
+		indexSlabs.upload(mesh.indices, offset, size, data);
+	}
+
+	// a placed mesh whose flagged ranges are fully written; later meshes with its content share them
+	void publish(const PoolUpload& upload, const PoolPlacement& placement)
+	{
+		if (placement.writeVertices)
+			vertexGeometry.publish(placement.mesh.vertices, (uint32_t)upload.vertices.size(), (uint32_t)upload.layout.stride, upload.vertexKey);
+		if (placement.writeIndices)
+			indexGeometry.publish(placement.mesh.indices, (uint32_t)upload.indices.size(), upload.indexSize(), upload.indexKey);
+	}
+
+	void remove(PooledMesh& mesh)
+	{
+		vertexGeometry.release(mesh.vertices);
+		indexGeometry.release(mesh.indices);
+		mesh = PooledMesh();
+	}
+
+	// first vertex of the mesh within its slab, the basevertex / first argument of the draw
+	GLint baseVertex(const PooledMesh& mesh) const
+	{
+		return (GLint)(vertexSlabs.offset(mesh.vertices) / mesh.stride);
+	}
+
+	// byte offset of the mesh's indices, the indices argument of glDrawElements*
+	const void* indexOffset(const PooledMesh& mesh) const
+	{
+		return (const void*)(uintptr_t)indexSlabs.offset(mesh.indices);
+	}
+
+	// Runs setup with each of the pool's VAOs bound: the ones that exist now, and every one
+	// created later when a mesh lands in a new slab or layout. For attributes that are not part
+	// of any mesh, e.g. SceneBuffer's object index stream.
+	void setVertexArraySetup(std::function<void()> setup)
+	{
+		vertexArraySetup = std::move(setup);
+		if (!vertexArraySetup)
+			return;
+		for (const VertexArray& vertexArray : vertexArrayCache)
+		{
+			glState().bindVertexArray(vertexArray.name);
+			vertexArraySetup();
+		}
+		glState().bindVertexArray(0);
+	}
+
+	// every VAO the pool has created so far
+	std::vector<GLuint> vertexArrays() const
+	{
+		std::vector<GLuint> names;
+		for (const VertexArray& vertexArray : vertexArrayCache)
+			names.push_back(vertexArray.name);
+		return names;
+	}
+
+	// a step of compacting a vertex and an index slab, moving at most maxBytes each
+	bool defragment(uint32_t maxBytes)
+	{
+		bool vertexMoved = vertexSlabs.defragment(maxBytes);
+		bool indexMoved = indexSlabs.defragment(maxBytes);
+		return vertexMoved || indexMoved;
+	}
+
+	SlabStats vertexStats() const
+	{
+		return vertexSlabs.stats();
+	}
+
+	SlabStats indexStats() const
+	{
+		return indexSlabs.stats();
+	}
+
+	// slab usage and fragmentation of both halves of the pool
+	void report(std::ostream& out) const
+	{
+		reportSlabs(out, "vertex", vertexSlabs.stats());
+		reportSlabs(out, "index", indexSlabs.stats());
+		out << "Mesh pool deduplication: " << vertexGeometry.sharedRanges() << " vertex and " << indexGeometry.sharedRanges()
+			<< " index payloads shared, " << bytesSaved() << " bytes saved" << std::endl;
+	}
+
+	// bytes not uploaded because identical vertex or index content was already in the pool
+	uint64_t bytesSaved() const
+	{
+		return vertexGeometry.bytesSaved() + indexGeometry.bytesSaved();
+	}
+
+private:
+	static const uint32_t NO_SLAB = 0xFFFFFFFFu;
+
+	PooledMesh addRaw(const VertexLayout& layout, const void* vertices, GLsizei vertexCount, const void* indices, GLsizei indexCount, GLenum indexType)
+	{
+		PooledMesh mesh;
+		mesh.stride = layout.stride;
+		mesh.vertexCount = vertexCount;
+		mesh.indexCount = indexCount;
+		mesh.indexType = indexType;
+		mesh.vertices = vertexGeometry.acquire(vertices, vertexCount * layout.stride, layout.stride);
+		uint32_t indexSlab = NO_SLAB;
+		if (indices && indexCount > 0)
+		{
+			// index offsets must be a multiple of the index size
+			uint32_t indexSize = indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+			mesh.indices = indexGeometry.acquire(indices, indexCount * indexSize, indexSize);
+			indexSlab = indexSlabs.slab(mesh.indices);
+		}
+		mesh.vertexArray = vertexArrayFor(layout, vertexSlabs.slab(mesh.vertices), indexSlab);
+		return mesh;
+	}
+
+	PoolPlacement placeUpload(const PoolUpload& upload, bool write)
+	{
+		PoolPlacement placement;
+		if (upload.vertices.size() != (size_t)upload.vertexCount * upload.layout.stride)
+		{
+			std::cout << "ERROR::MESH_POOL::LAYOUT_MISMATCH " << upload.vertices.size() << " vertex bytes for "
+				<< upload.vertexCount << " vertices of stride " << upload.layout.stride << std::endl;
+			return placement;
+		}
+		PooledMesh& mesh = placement.mesh;
+		mesh.stride = upload.layout.stride;
+		mesh.vertexCount = upload.vertexCount;
+		mesh.indexCount = upload.indexCount;
+		mesh.indexType = upload.indexType;
+		mesh.decode = upload.decode;
+		bool written = true;
+		mesh.vertices = vertexGeometry.acquire(write ? upload.vertices.data() : nullptr, (uint32_t)upload.vertices.size(),
+			(uint32_t)upload.layout.stride, upload.vertexKey, &written);
+		placement.writeVertices = !written;
+		uint32_t indexSlab = NO_SLAB;
+		if (!upload.indices.empty())
+		{
+			mesh.indices = indexGeometry.acquire(write ? upload.indices.data() : nullptr, (uint32_t)upload.indices.size(),
+				upload.indexSize(), upload.indexKey, &written);
+			placement.writeIndices = !written;
+			indexSlab = indexSlabs.slab(mesh.indices);
+		}
+		mesh.vertexArray = vertexArrayFor(upload.layout, vertexSlabs.slab(mesh.vertices), indexSlab);
+		return placement;
+	}
+
+	struct VertexArray
+	{
+		VertexLayout layout;
+		uint32_t vertexSlab;
+		uint32_t indexSlab;
+		GpuResource owner;
+		GLuint name;
+	};
+
+	SlabAllocator vertexSlabs;
+	SlabAllocator indexSlabs;
+	GeometryRegistry vertexGeometry;
+	GeometryRegistry indexGeometry;
+	std::vector<VertexArray> vertexArrayCache;
+	std::function<void()> vertexArraySetup;
+
+	GLuint vertexArrayFor(const VertexLayout& layout, uint32_t vertexSlab, uint32_t indexSlab)
+	{
+		for (const VertexArray& vertexArray : vertexArrayCache)
+			if (vertexArray.vertexSlab == vertexSlab && vertexArray.indexSlab == indexSlab && vertexArray.layout == layout)
+				return vertexArray.name;
+
+		VertexArray vertexArray;
+		vertexArray.layout = layout;
+		vertexArray.vertexSlab = vertexSlab;
+		vertexArray.indexSlab = indexSlab;
+		vertexArray.owner = makeVertexArray("mesh pool");
+		vertexArray.name = vertexArray.owner.id();
+
+		glState().bindVertexArray(vertexArray.name);
+		glState().bindBuffer(GL_ARRAY_BUFFER, vertexSlabs.slabBuffer(vertexSlab));
+		if (indexSlab != NO_SLAB)
+			glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexSlabs.slabBuffer(indexSlab));
+		setupVertexAttributes(layout);
+		if (vertexArraySetup)
+			vertexArraySetup();
+		glState().bindVertexArray(0);
+
+		vertexArrayCache.push_back(std::move(vertexArray));
+		return vertexArrayCache.back().name;
+	}
+
+	static void reportSlabs(std::ostream& out, const char* name, const SlabStats& stats)
+	{
+		out << "Mesh pool " << name << " slabs: " << stats.slabs << " slabs, " << stats.ranges.allocations << " ranges, "
+			<< stats.ranges.usedBytes / 1024 << " / " << stats.ranges.capacity / 1024 << " KiB used, "
+			<< stats.ranges.freeRanges << " free ranges, largest " << stats.ranges.largestFree / 1024 << " KiB, "
+			<< "fragmentation " << (int)(stats.fragmentation() * 100.0f) << "%" << std::endl;
+	}
+};
+#endif
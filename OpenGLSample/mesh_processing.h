@@ -0,0 +1,493 @@
+#ifndef MESH_PROCESSING_H
+#define MESH_PROCESSING_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// CPU-side stage every mesh passes through before it is uploaded, generated or imported alike.
+// Meshes are interleaved float vertices with the position in the first three floats (the
+// procedural layouts and mesh.h's Vertex both qualify), optionally with triangle indices.
+
+// 16-bit whenever every index fits; draws add the base vertex after the fetch, so this only
+// depends on the mesh's own vertex count
+inline GLenum indexTypeFor(uint32_t vertexCount)
+{
+	return vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+// the indices converted to type, ready to upload
+inline std::vector<unsigned char> packIndices(const std::vector<uint32_t>& indices, GLenum type)
+{
+	if (type == GL_UNSIGNED_INT)
+	{
+		std::vector<unsigned char> packed(indices.size() * 4);
+		if (!indices.empty())
+			memcpy(packed.data(), indices.data(), packed.size());
+		return packed;
+	}
+	std::vector<unsigned char> packed(indices.size() * 2);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		uint16_t index = (uint16_t)indices[i];
+		memcpy(&packed[i * 2], &index, 2);
+	}
+	return packed;
+}
+
+// a processed mesh, in the form MeshPool uploads
+struct IndexedMesh
+{
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+	uint32_t floatsPerVertex = 0;
+
+	uint32_t vertexCount() const
+	{
+		return floatsPerVertex ? (uint32_t)(vertices.size() / floatsPerVertex) : 0;
+	}
+
+	GLenum indexType() const
+	{
+		return indexTypeFor(vertexCount());
+	}
+
+	uint32_t indexSize() const
+	{
+		return indexType() == GL_UNSIGNED_SHORT ? 2 : 4;
+	}
+
+	std::vector<unsigned char> packedIndices() const
+	{
+		return packIndices(indices, indexType());
+	}
+};
+
+// totals over every mesh processed so far, for the startup report
+struct MeshProcessingStats
+{
+	uint64_t meshes = 0;
+	uint64_t inputVertices = 0;
+	uint64_t outputVertices = 0;
+	uint64_t inputVertexBytes = 0;
+	uint64_t outputVertexBytes = 0;
+	uint64_t inputIndexBytes = 0;   // 32-bit input indices; none for unindexed input
+	uint64_t outputIndexBytes = 0;
+	uint64_t triangles = 0;
+	uint64_t transformsBefore = 0;  // simulated vertex-shader runs of the welded mesh in its original order
+	uint64_t transformsAfter = 0;   // and after the cache optimization
+	uint64_t quantizedMeshes = 0;   // meshes packed by quantizeMesh (vertex_quantization.h)
+	uint64_t floatVertexBytes = 0;
+	uint64_t packedVertexBytes = 0;
+	uint64_t floatFetchBytes = 0;   // vertex bytes one draw of every packed mesh would read as floats
+	uint64_t packedFetchBytes = 0;
+
+	void report(std::ostream& out) const
+	{
+		out << "Mesh processing: " << meshes << " meshes, vertices " << inputVertices << " -> " << outputVertices
+			<< ", vertex bytes " << inputVertexBytes << " -> " << outputVertexBytes
+			<< ", index bytes " << inputIndexBytes << " -> " << outputIndexBytes << std::endl;
+		if (triangles == 0 || outputVertices == 0)
+			return;
+		out << "Vertex cache: ACMR " << (double)transformsBefore / triangles << " -> " << (double)transformsAfter / triangles
+			<< ", ATVR " << (double)transformsBefore / outputVertices << " -> " << (double)transformsAfter / outputVertices << std::endl;
+		if (quantizedMeshes == 0 || packedVertexBytes == 0)
+			return;
+		out << "Vertex packing: " << quantizedMeshes << " meshes, vertex memory " << floatVertexBytes << " -> " << packedVertexBytes
+			<< " bytes, fetched per draw " << floatFetchBytes << " -> " << packedFetchBytes << " bytes ("
+			<< (double)floatVertexBytes / packedVertexBytes << "x smaller)" << std::endl;
+	}
+};
+
+inline MeshProcessingStats& meshProcessingStats()
+{
+	static MeshProcessingStats stats;
+	return stats;
+}
+
+// held while adding to meshProcessingStats(); meshes are also processed on worker threads
+inline std::mutex& meshProcessingStatsMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
+struct WeldOptions
+{
+	float positionEpsilon = 1e-5f;   // positions closer than this on every axis are the same point
+	float attributeEpsilon = 1e-4f;  // normals, UVs etc. must also agree within this to merge
+};
+
+// Merges vertices that are the same point with the same attributes, so a seam (same position,
+// different normal or UV) is kept while the duplicated corners of unindexed triangles collapse.
+// Candidates are found with a spatial hash on positions: the grid cell is positionEpsilon wide,
+// so a match can only sit in the 27 cells around a vertex. Unindexed input is treated as a
+// triangle list (0, 1, 2, ...). The result's first use of each vertex keeps the input order.
+inline IndexedMesh weldVertices(const float* vertices, uint32_t vertexCount, uint32_t floatsPerVertex,
+	const uint32_t* indices = nullptr, uint32_t indexCount = 0, const WeldOptions& options = WeldOptions())
+{
+	IndexedMesh result;
+	result.floatsPerVertex = floatsPerVertex;
+	float inverseCell = 1.0f / options.positionEpsilon;
+
+	auto cellKey = [](int64_t x, int64_t y, int64_t z)
+	{
+		return (uint64_t)(x * 73856093) ^ (uint64_t)(y * 19349663) ^ (uint64_t)(z * 83492791);
+	};
+	auto matches = [&](const float* a, const float* b)
+	{
+		for (uint32_t i = 0; i < floatsPerVertex; i++)
+		{
+			float epsilon = i < 3 ? options.positionEpsilon : options.attributeEpsilon;
+			if (std::fabs(a[i] - b[i]) > epsilon)
+				return false;
+		}
+		return true;
+	};
+
+	std::unordered_map<uint64_t, std::vector<uint32_t> > grid;
+	std::vector<uint32_t> remap(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		const float* vertex = vertices + (size_t)v * floatsPerVertex;
+		int64_t cx = (int64_t)std::floor(vertex[0] * inverseCell);
+		int64_t cy = (int64_t)std::floor(vertex[1] * inverseCell);
+		int64_t cz = (int64_t)std::floor(vertex[2] * inverseCell);
+
+		uint32_t found = UINT32_MAX;
+		for (int64_t dx = -1; dx <= 1 && found == UINT32_MAX; dx++)
+			for (int64_t dy = -1; dy <= 1 && found == UINT32_MAX; dy++)
+				for (int64_t dz = -1; dz <= 1 && found == UINT32_MAX; dz++)
+				{
+					auto cell = grid.find(cellKey(cx + dx, cy + dy, cz + dz));
+					if (cell == grid.end())
+						continue;
+					for (uint32_t candidate : cell->second)
+					{
+						if (matches(vertex, &result.vertices[(size_t)candidate * floatsPerVertex]))
+						{
+							found = candidate;
+							break;
+						}
+					}
+				}
+
+		if (found == UINT32_MAX)
+		{
+			found = result.vertexCount();
+			result.vertices.insert(result.vertices.end(), vertex, vertex + floatsPerVertex);
+			grid[cellKey(cx, cy, cz)].push_back(found);
+		}
+		remap[v] = found;
+	}
+
+	if (indices)
+	{
+		result.indices.resize(indexCount);
+		for (uint32_t i = 0; i < indexCount; i++)
+			result.indices[i] = remap[indices[i]];
+	}
+	else
+		result.indices = remap;
+	return result;
+}
+
+// Vertex-shader runs needed to draw a triangle list through a FIFO post-transform cache of
+// cacheSize entries, the usual model of the hardware's reuse. Per triangle this is the ACMR
+// (ideal about 0.5), per vertex the ATVR (ideal 1.0).
+inline uint64_t simulateVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = 16)
+{
+	std::vector<uint64_t> insertedAt(vertexCount, 0);
+	uint64_t transforms = 0;
+	for (uint32_t index : indices)
+	{
+		// a vertex is still cached if fewer than cacheSize others were pushed since it was
+		if (insertedAt[index] == 0 || transforms - insertedAt[index] + 1 > cacheSize)
+		{
+			transforms++;
+			insertedAt[index] = transforms;
+		}
+	}
+	return transforms;
+}
+
+// Reorders triangles for post-transform cache reuse with Tom Forsyth's linear-speed algorithm:
+// every vertex is scored by its position in a simulated LRU cache and by how many triangles
+// still use it, and the next triangle emitted is the best scoring one among those touching the
+// cache. Vertices with few remaining triangles score high so fans get finished off instead of
+// leaving stragglers that need a second transform later.
+inline void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+	const int CACHE_SIZE = 32;
+	uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+	if (triangleCount == 0)
+		return;
+
+	auto vertexScore = [CACHE_SIZE](int cachePosition, uint32_t remaining)
+	{
+		if (remaining == 0)
+			return -1.0f;
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			// the last triangle's vertices get a fixed score so the next one does not simply reuse its edge
+			if (cachePosition < 3)
+				score = 0.75f;
+			else
+				score = std::pow(1.0f - (float)(cachePosition - 3) / (float)(CACHE_SIZE - 3), 1.5f);
+		}
+		return score + 2.0f / std::sqrt((float)remaining);
+	};
+
+	// triangles using each vertex, as offsets into one shared list
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : indices)
+		remaining[index]++;
+	std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> filled(vertexCount, 0);
+	for (uint32_t t = 0; t < triangleCount; t++)
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			uint32_t v = indices[t * 3 + k];
+			adjacency[firstTriangle[v] + filled[v]++] = t;
+		}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		score[v] = vertexScore(-1, remaining[v]);
+	std::vector<float> triangleScore(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; t++)
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> nextCache;
+	uint32_t scanCursor = 0;
+	int best = (int)(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+	while (best >= 0)
+	{
+		emitted[best] = true;
+		nextCache.clear();
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			uint32_t v = indices[best * 3 + k];
+			output.push_back(v);
+			nextCache.push_back(v);
+
+			// drop the triangle from the vertex's live list
+			uint32_t* begin = &adjacency[firstTriangle[v]];
+			uint32_t* end = begin + remaining[v];
+			*std::find(begin, end, (uint32_t)best) = *(end - 1);
+			remaining[v]--;
+		}
+		for (uint32_t v : cache)
+			if (std::find(nextCache.begin(), nextCache.begin() + 3, v) == nextCache.begin() + 3)
+				nextCache.push_back(v);
+
+		// rescore everything that moved in or fell out of the cache
+		for (size_t i = 0; i < nextCache.size(); i++)
+		{
+			uint32_t v = nextCache[i];
+			cachePosition[v] = i < (size_t)CACHE_SIZE ? (int)i : -1;
+			score[v] = vertexScore(cachePosition[v], remaining[v]);
+		}
+		best = -1;
+		float bestScore = -1.0f;
+		for (uint32_t v : nextCache)
+			for (uint32_t i = 0; i < remaining[v]; i++)
+			{
+				uint32_t t = adjacency[firstTriangle[v] + i];
+				triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = (int)t;
+				}
+			}
+		if (nextCache.size() > (size_t)CACHE_SIZE)
+			nextCache.resize(CACHE_SIZE);
+		cache.swap(nextCache);
+
+		// nothing adjacent to the cache is left: continue with the next untouched triangle
+		if (best < 0)
+		{
+			while (scanCursor < triangleCount && emitted[scanCursor])
+				scanCursor++;
+			if (scanCursor < triangleCount)
+				best = (int)scanCursor;
+		}
+	}
+	indices.swap(output);
+}
+
+// Reorders clusters of the cache-optimized triangle list so the outward-facing parts of the mesh
+// tend to be drawn first and occlude the rest (a simplified Sander/Nehab/Barczak ordering).
+// Clusters are cut where the simulated cache starts over (a triangle with three misses), which
+// keeps the cache behaviour within each cluster; the new order is only kept if the ACMR grows
+// by less than threshold.
+inline void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<float>& vertices, uint32_t floatsPerVertex, float threshold = 1.05f)
+{
+	uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+	uint32_t vertexCount = (uint32_t)(vertices.size() / floatsPerVertex);
+	if (triangleCount < 2)
+		return;
+
+	std::vector<uint32_t> clusterStart;
+	std::vector<uint64_t> insertedAt(vertexCount, 0);
+	uint64_t transforms = 0;
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		uint32_t misses = 0;
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			uint32_t v = indices[t * 3 + k];
+			if (insertedAt[v] == 0 || transforms - insertedAt[v] + 1 > 16)
+			{
+				transforms++;
+				insertedAt[v] = transforms;
+				misses++;
+			}
+		}
+		if (t == 0 || misses == 3)
+			clusterStart.push_back(t);
+	}
+	clusterStart.push_back(triangleCount);
+	uint32_t clusterCount = (uint32_t)clusterStart.size() - 1;
+	if (clusterCount < 2)
+		return;
+
+	auto position = [&](uint32_t v, uint32_t axis)
+	{
+		return vertices[(size_t)v * floatsPerVertex + axis];
+	};
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t v = 0; v < vertexCount; v++)
+		for (uint32_t axis = 0; axis < 3; axis++)
+			meshCentroid[axis] += position(v, axis) / (float)vertexCount;
+
+	// sort key: how far the cluster's area-weighted normal points away from the mesh centre
+	std::vector<float> key(clusterCount);
+	for (uint32_t c = 0; c < clusterCount; c++)
+	{
+		float centroid[3] = { 0.0f, 0.0f, 0.0f };
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f;
+		for (uint32_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+		{
+			uint32_t a = indices[t * 3], b = indices[t * 3 + 1], d = indices[t * 3 + 2];
+			float e1[3], e2[3];
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				e1[axis] = position(b, axis) - position(a, axis);
+				e2[axis] = position(d, axis) - position(a, axis);
+			}
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				centroid[axis] += (position(a, axis) + position(b, axis) + position(d, axis)) / 3.0f * triangleArea;
+				normal[axis] += n[axis];
+			}
+			area += triangleArea;
+		}
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (area <= 0.0f || length <= 0.0f)
+		{
+			key[c] = 0.0f;
+			continue;
+		}
+		key[c] = 0.0f;
+		for (uint32_t axis = 0; axis < 3; axis++)
+			key[c] += (centroid[axis] / area - meshCentroid[axis]) * normal[axis] / length;
+	}
+
+	std::vector<uint32_t> order(clusterCount);
+	for (uint32_t c = 0; c < clusterCount; c++)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&key](uint32_t a, uint32_t b)
+	{
+		return key[a] > key[b];
+	});
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(indices.size());
+	for (uint32_t c : order)
+		sorted.insert(sorted.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+	if ((float)simulateVertexCache(sorted, vertexCount) <= (float)transforms * threshold)
+		indices.swap(sorted);
+}
+
+// Renumbers vertices in the order the index buffer first uses them and moves the vertex data
+// to match, so the vertex fetches of consecutive triangles hit neighbouring memory.
+inline void optimizeVertexFetch(IndexedMesh& mesh)
+{
+	uint32_t vertexCount = mesh.vertexCount();
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	std::vector<float> vertices;
+	vertices.reserve(mesh.vertices.size());
+	uint32_t next = 0;
+	for (uint32_t& index : mesh.indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = next++;
+			const float* vertex = &mesh.vertices[(size_t)index * mesh.floatsPerVertex];
+			vertices.insert(vertices.end(), vertex, vertex + mesh.floatsPerVertex);
+		}
+		index = remap[index];
+	}
+	// vertices no triangle references are dropped
+	mesh.vertices.swap(vertices);
+}
+
+struct ProcessOptions
+{
+	bool optimizeCache = true;
+	bool optimizeOverdraw = false;  // trades a little cache efficiency for early depth rejection
+};
+
+// The whole stage: welding, triangle order for the post-transform cache (and optionally for
+// overdraw), vertex order for fetch, then index narrowing. Accumulates meshProcessingStats().
+inline IndexedMesh processMesh(const float* vertices, uint32_t vertexCount, uint32_t floatsPerVertex,
+	const uint32_t* indices = nullptr, uint32_t indexCount = 0, const ProcessOptions& options = ProcessOptions())
+{
+	IndexedMesh mesh = weldVertices(vertices, vertexCount, floatsPerVertex, indices, indexCount);
+	uint64_t transformsBefore = simulateVertexCache(mesh.indices, mesh.vertexCount());
+	if (options.optimizeCache)
+	{
+		optimizeVertexCache(mesh.indices, mesh.vertexCount());
+		if (options.optimizeOverdraw)
+			optimizeOverdraw(mesh.indices, mesh.vertices, floatsPerVertex);
+		optimizeVertexFetch(mesh);
+	}
+
+	uint64_t transformsAfter = simulateVertexCache(mesh.indices, mesh.vertexCount());
+	std::lock_guard<std::mutex> lock(meshProcessingStatsMutex());
+	MeshProcessingStats& stats = meshProcessingStats();
+	stats.meshes++;
+	stats.inputVertices += vertexCount;
+	stats.outputVertices += mesh.vertexCount();
+	stats.inputVertexBytes += (uint64_t)vertexCount * floatsPerVertex * sizeof(float);
+	stats.outputVertexBytes += mesh.vertices.size() * sizeof(float);
+	stats.inputIndexBytes += (uint64_t)(indices ? indexCount : 0) * sizeof(uint32_t);
+	stats.outputIndexBytes += (uint64_t)mesh.indices.size() * mesh.indexSize();
+	stats.triangles += mesh.indices.size() / 3;
+	stats.transformsBefore += transformsBefore;
+	stats.transformsAfter += transformsAfter;
+	return mesh;
+}
+#endif
@@ -0,0 +1,234 @@
+#ifndef MESH_REBUILDER_H
+#define MESH_REBUILDER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "lod.h"
+#include "mesh_pool.h"
+#include "meshlet.h"
+#include "mesh_processing.h"
+#include "vertex_quantization.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Rebuilds a LOD chain in the background when the shape behind it changes. A worker thread does
+// all the CPU work (generation, processMesh, meshlets, packing, index narrowing and the hashes
+// the pool deduplicates by); the render thread only places the levels in the pool and copies
+// their bytes in, at most CHAIN_UPLOAD_BYTES_PER_FRAME a frame, then fences the last write. The
+// old chain keeps drawing the whole time and is swapped out at the start of the first frame
+// after the fence has signalled, so an edit never stalls a frame on generation or on the upload.
+//
+// Requests coalesce: a request the worker has not started replaces the previous one, so dragging
+// a parameter through many values builds only the newest of them once the worker is free.
+
+// rebuilt geometry copied into the pool per frame; larger levels are spread over several frames
+const uint32_t CHAIN_UPLOAD_BYTES_PER_FRAME = 1024 * 1024;
+
+// one level after all CPU work, ready for the pool
+struct PreparedLevel
+{
+	PoolUpload upload;          // packed or float vertices, narrowed indices, both hashed
+	GLsizei indexCount = 0;
+	float error = 0.0f;
+	std::vector<Meshlet> meshlets;
+};
+
+// cuts a processed mesh into meshlets, packs it if asked and readies it for the pool; safe on any thread
+inline PreparedLevel prepareLevel(IndexedMesh processed, const VertexLayout& layout, bool pack, float error)
+{
+	PreparedLevel level;
+	level.meshlets = buildMeshlets(processed);
+	level.indexCount = (GLsizei)processed.indices.size();
+	level.error = error;
+	level.upload = pack ? preparePoolUpload(quantizeMesh(processed, quantizeSourceFor(layout))) : preparePoolUpload(layout, processed);
+	return level;
+}
+
+// the upload half, in one go, on the GL thread
+inline PooledMesh uploadLevel(MeshPool& pool, const PreparedLevel& level)
+{
+	return pool.add(level.upload);
+}
+
+// the levels of a chain, finest first, with the chain's bounding sphere
+struct PreparedChain
+{
+	std::vector<PreparedLevel> levels;
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+};
+
+class ChainRebuilder
+{
+public:
+	using Build = std::function<PreparedChain()>;
+
+	ChainRebuilder()
+		: worker(&ChainRebuilder::run, this)
+	{
+	}
+
+	ChainRebuilder(const ChainRebuilder&) = delete;
+	ChainRebuilder& operator=(const ChainRebuilder&) = delete;
+
+	// waits for a build in progress; delete while the context still exists. Levels uploaded but
+	// never swapped in stay allocated in the pool until the pool goes.
+	~ChainRebuilder()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		worker.join();
+		if (fence)
+			glDeleteSync(fence);
+	}
+
+	// runs build() on the worker, replacing a request it has not started yet
+	void request(Build build)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending = std::move(build);
+		}
+		wake.notify_one();
+	}
+
+	// true from a request until its chain has been swapped in
+	bool busy() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return pending || building || ready || uploading || fence;
+	}
+
+	// Call once per frame on the render thread, before the chain is selected and drawn. Writes at
+	// most CHAIN_UPLOAD_BYTES_PER_FRAME, and on the frame the chain is replaced returns true: the
+	// old levels are back in the pool and whoever drew from the chain must pick its level again.
+	bool update(MeshPool& pool, LodChain& chain)
+	{
+		if (fence)
+		{
+			if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+				return false;
+			glDeleteSync(fence);
+			fence = 0;
+			for (LodLevel& level : chain.levels)
+				pool.remove(level.geometry);
+			chain = std::move(uploaded);
+			uploaded = LodChain();
+			return true;
+		}
+
+		if (!uploading)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!ready)
+				return false;
+			built = std::move(result);
+			result = PreparedChain();
+			ready = false;
+			if (built.levels.empty())
+				return false;
+			uploading = true;
+			placed = false;
+			uploaded = LodChain();
+			uploaded.center = built.center;
+			uploaded.radius = built.radius;
+		}
+
+		// a finely tessellated chain is never written in a single frame
+		uint32_t budget = CHAIN_UPLOAD_BYTES_PER_FRAME;
+		while (budget > 0 && uploaded.levels.size() < built.levels.size())
+		{
+			const PreparedLevel& level = built.levels[uploaded.levels.size()];
+			if (!placed)
+			{
+				placement = pool.place(level.upload);
+				vertexBytesWritten = placement.writeVertices ? 0 : (uint32_t)level.upload.vertices.size();
+				indexBytesWritten = placement.writeIndices ? 0 : (uint32_t)level.upload.indices.size();
+				placed = true;
+			}
+			budget -= writeChunk(pool, level.upload.vertices, vertexBytesWritten, budget, false);
+			budget -= writeChunk(pool, level.upload.indices, indexBytesWritten, budget, true);
+			if (vertexBytesWritten < level.upload.vertices.size() || indexBytesWritten < level.upload.indices.size())
+				break;
+			pool.publish(level.upload, placement);
+			uploaded.addLevel(placement.mesh, level.indexCount, level.error, level.meshlets);
+			placed = false;
+		}
+		if (uploaded.levels.size() == built.levels.size())
+		{
+			fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			built = PreparedChain();
+			uploading = false;
+		}
+		return false;
+	}
+
+private:
+	// writes the next at most budget bytes of a payload of the placed level; returns how many
+	uint32_t writeChunk(MeshPool& pool, const std::vector<unsigned char>& bytes, uint32_t& written, uint32_t budget, bool indices)
+	{
+		uint32_t size = std::min(budget, (uint32_t)bytes.size() - written);
+		if (size == 0)
+			return 0;
+		if (indices)
+			pool.writeIndices(placement.mesh, written, size, bytes.data() + written);
+		else
+			pool.writeVertices(placement.mesh, written, size, bytes.data() + written);
+		written += size;
+		return size;
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			wake.wait(lock, [this]() { return stopping || pending; });
+			if (stopping)
+				return;
+			Build build = std::move(pending);
+			pending = nullptr;
+			building = true;
+			lock.unlock();
+			PreparedChain chain = build();
+			lock.lock();
+			building = false;
+			// a result the render thread has not collected yet is superseded
+			result = std::move(chain);
+			ready = true;
+		}
+	}
+
+	// shared with the worker, under the mutex
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	Build pending;
+	PreparedChain result;
+	bool building = false;
+	bool ready = false;
+	bool stopping = false;
+
+	// render thread only
+	PreparedChain built;        // being uploaded
+	LodChain uploaded;          // levels uploaded so far
+	bool uploading = false;
+	PoolPlacement placement;    // the level being written, while placed is set
+	bool placed = false;
+	uint32_t vertexBytesWritten = 0;
+	uint32_t indexBytesWritten = 0;
+	GLsync fence = 0;
+
+	std::thread worker;         // last, so it starts after everything it reads
+};
+#endif
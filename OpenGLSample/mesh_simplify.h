@@ -0,0 +1,400 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "lod.h"
+#include "mesh_processing.h"
+#include "mesh_rebuilder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Quadric error metric simplification (Garland & Heckbert) for arbitrary indexed meshes, e.g.
+// imported content in mesh.h's Mesh. Vertices are removed by half-edge collapses: a vertex is
+// merged into a neighbour and takes that neighbour's position and attributes, so no attribute is
+// ever interpolated. Every position carries the quadric of the triangle planes around it (area
+// weighted); a collapse costs the squared distance of the kept position from the planes of both
+// ends, and the cheapest collapses go first.
+//
+// Vertices sharing a position (a normal or UV seam; in a flat-shaded import, every vertex) move
+// together, so the sides of a seam never come apart: a seam vertex collapses only along the
+// seam, onto another seam position, and every copy of it goes along. A copy that shares an edge
+// with a copy of the target merges into it like any half-edge collapse; the others are moved to
+// the target position and keep their own normal and UV. Borders are preserved exactly: a
+// position on an open or non-manifold edge never moves; vertices may still collapse onto it.
+
+struct SimplifyOptions
+{
+	uint32_t targetTriangles = 0;   // stop once the mesh is down to this many triangles
+	float targetError = 1e30f;      // ...or once the next collapse would move the surface further than this (object space)
+};
+
+struct SimplifiedMesh
+{
+	IndexedMesh mesh;
+	float error = 0.0f;             // largest deviation from the input introduced, object space
+};
+
+// symmetric 4x4 matrix of a sum of weighted squared plane distances
+struct Quadric
+{
+	double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+	double weight = 0;
+
+	static Quadric fromPlane(double a, double b, double c, double d, double weight)
+	{
+		Quadric q;
+		q.a2 = a * a * weight; q.ab = a * b * weight; q.ac = a * c * weight; q.ad = a * d * weight;
+		q.b2 = b * b * weight; q.bc = b * c * weight; q.bd = b * d * weight;
+		q.c2 = c * c * weight; q.cd = c * d * weight;
+		q.d2 = d * d * weight;
+		q.weight = weight;
+		return q;
+	}
+
+	void add(const Quadric& q)
+	{
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+		weight += q.weight;
+	}
+
+	// mean squared distance of the point from the planes
+	double error(const float* p) const
+	{
+		double x = p[0], y = p[1], z = p[2];
+		double sum = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+			+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+			+ c2 * z * z + 2 * cd * z + d2;
+		return weight > 0 ? std::fabs(sum) / weight : 0.0;
+	}
+};
+
+inline SimplifiedMesh simplifyMesh(const IndexedMesh& source, const SimplifyOptions& options)
+{
+	SimplifiedMesh result;
+	uint32_t vertexCount = source.vertexCount();
+	uint32_t floats = source.floatsPerVertex;
+	std::vector<float> vertices = source.vertices;     // seam collapses move vertices
+	std::vector<uint32_t> indices = source.indices;
+	auto position = [&](uint32_t v) { return vertices.data() + (size_t)v * floats; };
+	const uint32_t NO_VERTEX = UINT32_MAX;
+
+	// vertices at the same position: more than one means a seam
+	std::vector<uint32_t> positionCount(vertexCount, 0);
+	std::vector<uint32_t> group(vertexCount);
+	{
+		std::unordered_map<uint64_t, uint32_t> first;
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			uint64_t key = hashBytes(position(v), 3 * sizeof(float));
+			auto found = first.find(key);
+			if (found != first.end() && memcmp(position(found->second), position(v), 3 * sizeof(float)) == 0)
+				group[v] = found->second;
+			else
+			{
+				group[v] = v;
+				first[key] = v;
+			}
+			positionCount[group[v]]++;
+		}
+	}
+	// the vertices of each position as a list from the group's first copy
+	std::vector<uint32_t> firstCopy(vertexCount, NO_VERTEX), nextCopy(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		nextCopy[v] = firstCopy[group[v]];
+		firstCopy[group[v]] = v;
+	}
+
+	// open and non-manifold edges, counted between positions so seams do not read as borders
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::unordered_map<uint64_t, uint32_t> edgeUse;
+		auto edgeKey = [](uint32_t a, uint32_t b) { return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a; };
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+			for (int k = 0; k < 3; k++)
+				edgeUse[edgeKey(group[indices[t + k]], group[indices[t + (k + 1) % 3]])]++;
+		for (const auto& edge : edgeUse)
+			if (edge.second != 2)
+			{
+				locked[(uint32_t)(edge.first >> 32)] = true;
+				locked[(uint32_t)(edge.first & 0xFFFFFFFFu)] = true;
+			}
+		for (uint32_t v = 0; v < vertexCount; v++)
+			locked[v] = locked[group[v]];
+	}
+
+	// per position, indexed by its group
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		glm::vec3 p0 = glm::make_vec3(position(indices[t]));
+		glm::vec3 p1 = glm::make_vec3(position(indices[t + 1]));
+		glm::vec3 p2 = glm::make_vec3(position(indices[t + 2]));
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float area = glm::length(normal);
+		if (area <= 0.0f)
+			continue;
+		normal /= area;
+		Quadric plane = Quadric::fromPlane(normal.x, normal.y, normal.z, -glm::dot(normal, p0), area * 0.5f);
+		for (int k = 0; k < 3; k++)
+			quadrics[group[indices[t + k]]].add(plane);
+	}
+
+	struct Collapse
+	{
+		uint32_t from, to;
+		double cost;
+	};
+	double maxCost = (double)options.targetError * options.targetError;
+	double worstCost = 0.0;
+	uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<uint32_t> firstTriangle(vertexCount + 1), adjacency;
+	std::vector<std::pair<uint32_t, uint32_t> > moves;     // every copy a collapse moves, with the vertex it merges into or NO_VERTEX
+
+	while (triangleCount > options.targetTriangles)
+	{
+		// vertex -> triangles, rebuilt every pass
+		std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+		for (uint32_t index : indices)
+			firstTriangle[index + 1]++;
+		for (uint32_t v = 0; v < vertexCount; v++)
+			firstTriangle[v + 1] += firstTriangle[v];
+		adjacency.assign(indices.size(), 0);
+		std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (uint32_t t = 0; t < triangleCount; t++)
+			for (int k = 0; k < 3; k++)
+				adjacency[fill[indices[t * 3 + k]]++] = t;
+
+		// a vertex of the position toGroup in a triangle around v
+		auto neighbourAt = [&](uint32_t v, uint32_t toGroup)
+		{
+			for (uint32_t i = firstTriangle[v]; i < firstTriangle[v + 1]; i++)
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t other = indices[adjacency[i] * 3 + k];
+					if (group[other] == toGroup && other != v)
+						return other;
+				}
+			return NO_VERTEX;
+		};
+
+		std::vector<Collapse> candidates;
+		for (uint32_t t = 0; t < triangleCount; t++)
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t a = indices[t * 3 + k], b = indices[t * 3 + (k + 1) % 3];
+				for (int direction = 0; direction < 2; direction++)
+				{
+					uint32_t from = direction ? b : a, to = direction ? a : b;
+					// a seam vertex may only slide along the seam
+					if (locked[from] || (positionCount[group[from]] > 1 && positionCount[group[to]] == 1))
+						continue;
+					Quadric q = quadrics[group[from]];
+					q.add(quadrics[group[to]]);
+					candidates.push_back({ from, to, q.error(position(to)) });
+				}
+			}
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		for (uint32_t v = 0; v < vertexCount; v++)
+			remap[v] = v;
+		std::fill(touched.begin(), touched.end(), false);
+		uint32_t collapsed = 0;
+		uint32_t goal = triangleCount - options.targetTriangles;
+		for (const Collapse& collapse : candidates)
+		{
+			if (collapse.cost > maxCost || collapsed >= goal)
+				break;
+
+			// every used copy of the position moves, into its own neighbour at the target where it has one
+			uint32_t fromGroup = group[collapse.from], toGroup = group[collapse.to];
+			moves.clear();
+			bool free = true;
+			for (uint32_t copy = firstCopy[fromGroup]; copy != NO_VERTEX && free; copy = nextCopy[copy])
+			{
+				if (firstTriangle[copy] == firstTriangle[copy + 1])
+					continue;
+				uint32_t partner = copy == collapse.from ? collapse.to : neighbourAt(copy, toGroup);
+				free = !touched[copy] && (partner == NO_VERTEX || !touched[partner]);
+				moves.push_back(std::make_pair(copy, partner));
+			}
+			if (!free)
+				continue;
+
+			// the collapse must not flip any triangle that stays
+			bool flips = false;
+			uint32_t removed = 0;
+			for (size_t m = 0; m < moves.size() && !flips; m++)
+			{
+				uint32_t from = moves[m].first, to = moves[m].second;
+				for (uint32_t i = firstTriangle[from]; i < firstTriangle[from + 1] && !flips; i++)
+				{
+					const uint32_t* triangle = &indices[adjacency[i] * 3];
+					if (to != NO_VERTEX && (triangle[0] == to || triangle[1] == to || triangle[2] == to))
+					{
+						removed++;
+						continue;
+					}
+					glm::vec3 before[3], after[3];
+					for (int k = 0; k < 3; k++)
+					{
+						before[k] = glm::make_vec3(position(triangle[k]));
+						after[k] = triangle[k] == from ? glm::make_vec3(position(collapse.to)) : before[k];
+					}
+					glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+					glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+					flips = glm::dot(oldNormal, newNormal) <= 0.0f;
+				}
+			}
+			if (flips)
+				continue;
+
+			quadrics[toGroup].add(quadrics[fromGroup]);
+			worstCost = std::max(worstCost, collapse.cost);
+			collapsed += removed;
+			// everything around the collapse changed shape; leave it to the next pass
+			for (const std::pair<uint32_t, uint32_t>& move : moves)
+			{
+				for (uint32_t i = firstTriangle[move.first]; i < firstTriangle[move.first + 1]; i++)
+					for (int k = 0; k < 3; k++)
+						touched[indices[adjacency[i] * 3 + k]] = true;
+				if (move.second != NO_VERTEX)
+				{
+					remap[move.first] = move.second;
+					touched[move.second] = true;
+				}
+				else
+				{
+					memcpy(position(move.first), position(collapse.to), 3 * sizeof(float));
+					positionCount[toGroup]++;
+				}
+			}
+			// the copies now belong to the target position
+			uint32_t last = NO_VERTEX;
+			for (uint32_t copy = firstCopy[fromGroup]; copy != NO_VERTEX; copy = nextCopy[copy])
+			{
+				group[copy] = toGroup;
+				last = copy;
+			}
+			nextCopy[last] = firstCopy[toGroup];
+			firstCopy[toGroup] = firstCopy[fromGroup];
+			firstCopy[fromGroup] = NO_VERTEX;
+		}
+		if (collapsed == 0)
+			break;
+
+		std::vector<uint32_t> kept;
+		kept.reserve(indices.size());
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			uint32_t a = remap[indices[t * 3]], b = remap[indices[t * 3 + 1]], c = remap[indices[t * 3 + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			kept.push_back(a);
+			kept.push_back(b);
+			kept.push_back(c);
+		}
+		indices.swap(kept);
+		triangleCount = (uint32_t)(indices.size() / 3);
+	}
+
+	// keep only the vertices the remaining triangles use
+	result.mesh.floatsPerVertex = floats;
+	result.mesh.indices = indices;
+	result.mesh.vertices = std::move(vertices);
+	optimizeVertexFetch(result.mesh);
+	result.error = (float)std::sqrt(worstCost);
+	return result;
+}
+
+// A source mesh and its simplified levels, ready for uploadLodChain: every level goes through
+// processMesh and prepareLevel (meshlets, packing if asked, index narrowing, hashes), so the GL
+// thread has nothing left to compute. Each level is simplified from the previous one down to
+// its triangle ratio (e.g. 0.5, 0.25, 0.125 of the input), so its error is the sum of the steps
+// that led to it. Pure CPU work; the result can also be handed to a ChainRebuilder.
+inline PreparedChain prepareSimplifiedChain(const IndexedMesh& source, const std::vector<float>& ratios, const VertexLayout& layout, bool pack)
+{
+	PreparedChain chain;
+	auto prepare = [&](const IndexedMesh& mesh, float error)
+	{
+		chain.levels.push_back(prepareLevel(processMesh(mesh.vertices.data(), mesh.vertexCount(), mesh.floatsPerVertex,
+			mesh.indices.data(), (uint32_t)mesh.indices.size()), layout, pack, error));
+	};
+	prepare(source, 0.0f);
+	uint32_t sourceTriangles = (uint32_t)(source.indices.size() / 3);
+	SimplifiedMesh previous;
+	previous.mesh = source;
+	for (float ratio : ratios)
+	{
+		SimplifyOptions options;
+		options.targetTriangles = (uint32_t)(sourceTriangles * ratio);
+		SimplifiedMesh level = simplifyMesh(previous.mesh, options);
+		level.error += previous.error;
+		prepare(level.mesh, level.error);
+		previous = std::move(level);
+	}
+
+	// bounding sphere around the box centre
+	uint32_t count = source.vertexCount();
+	if (count == 0)
+		return chain;
+	glm::vec3 low = glm::make_vec3(&source.vertices[0]), high = low;
+	for (uint32_t v = 1; v < count; v++)
+	{
+		glm::vec3 p = glm::make_vec3(&source.vertices[(size_t)v * source.floatsPerVertex]);
+		low = glm::min(low, p);
+		high = glm::max(high, p);
+	}
+	chain.center = (low + high) * 0.5f;
+	for (uint32_t v = 0; v < count; v++)
+		chain.radius = std::max(chain.radius, glm::length(glm::make_vec3(&source.vertices[(size_t)v * source.floatsPerVertex]) - chain.center));
+	return chain;
+}
+
+// prepareSimplifiedChain for every mesh, one worker per mesh on all hardware threads
+inline std::vector<PreparedChain> prepareSimplifiedChains(const std::vector<const IndexedMesh*>& meshes, const std::vector<float>& ratios,
+	const VertexLayout& layout, bool pack)
+{
+	std::vector<PreparedChain> chains(meshes.size());
+	std::atomic<size_t> next(0);
+	auto work = [&]()
+	{
+		for (size_t m = next++; m < meshes.size(); m = next++)
+			chains[m] = prepareSimplifiedChain(*meshes[m], ratios, layout, pack);
+	};
+
+	unsigned int workers = std::max(1u, std::min(std::thread::hardware_concurrency(), (unsigned int)meshes.size()));
+	std::vector<std::thread> threads;
+	for (unsigned int i = 1; i < workers; i++)
+		threads.emplace_back(work);
+	work();
+	for (std::thread& thread : threads)
+		thread.join();
+	return chains;
+}
+
+// uploads a prepared chain as a LodChain for selectLod; on the GL thread
+inline LodChain uploadLodChain(MeshPool& pool, const PreparedChain& prepared)
+{
+	LodChain chain;
+	for (const PreparedLevel& level : prepared.levels)
+		chain.addLevel(uploadLevel(pool, level), level.indexCount, level.error, level.meshlets);
+	chain.center = prepared.center;
+	chain.radius = prepared.radius;
+	return chain;
+}
+#endif
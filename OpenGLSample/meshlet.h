@@ -0,0 +1,285 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "mesh_processing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Meshlets: clusters of at most MESHLET_MAX_VERTICES distinct vertices and MESHLET_MAX_TRIANGLES
+// triangles, each one contiguous range of the mesh's index buffer. Every meshlet keeps a bounding
+// sphere and a cone bounding its triangle normals. Per frame the CPU drops meshlets outside the
+// frustum or facing entirely away from the camera and draws the survivors as a few merged index
+// ranges with one multi-draw.
+//
+// Meshlets grow from a seed triangle over shared vertices, preferring the neighbour that adds the
+// fewest vertices and then the one closest to the meshlet's facing, and stop at a crease rather
+// than wrap around a curve: a meshlet half way round a cylinder could never be culled.
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+// a triangle joins a meshlet only within this cosine of the meshlet's mean normal
+const float MESHLET_MIN_NORMAL_DOT = 0.85f;
+
+struct Meshlet
+{
+	uint32_t firstIndex = 0;    // into the mesh's own index range
+	uint32_t indexCount = 0;
+	glm::vec3 center = glm::vec3(0.0f);   // bounding sphere, object space
+	float radius = 0.0f;
+	glm::vec3 coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	float coneCutoff = 1.0f;    // sine of the cone's half angle; 1 means the cone never culls
+};
+
+// Bounding sphere and normal cone of a meshlet from the current positions of its vertices;
+// position(v) returns vertex v's position. buildMeshlets sets them once, and meshes whose
+// vertices move afterwards call this again so culling follows the edit.
+template <typename Position>
+inline void updateMeshletBounds(Meshlet& meshlet, const uint32_t* indices, Position position)
+{
+	uint32_t begin = meshlet.firstIndex, end = meshlet.firstIndex + meshlet.indexCount;
+	meshlet.radius = 0.0f;
+	meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 1.0f;
+	if (begin == end)
+		return;
+
+	glm::vec3 low = position(indices[begin]), high = low;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		low = glm::min(low, position(indices[i]));
+		high = glm::max(high, position(indices[i]));
+	}
+	meshlet.center = (low + high) * 0.5f;
+	for (uint32_t i = begin; i < end; i++)
+		meshlet.radius = std::max(meshlet.radius, glm::length(position(indices[i]) - meshlet.center));
+
+	// facing of each triangle, as wound
+	auto normal = [&](uint32_t first)
+	{
+		glm::vec3 p0 = position(indices[first]);
+		glm::vec3 n = glm::cross(position(indices[first + 1]) - p0, position(indices[first + 2]) - p0);
+		float length = glm::length(n);
+		return length > 0.0f ? n / length : glm::vec3(0.0f);
+	};
+	glm::vec3 sum(0.0f);
+	for (uint32_t i = begin; i + 2 < end; i += 3)
+		sum += normal(i);
+	float sumLength = glm::length(sum);
+	if (sumLength <= 0.0f)
+		return;
+	glm::vec3 axis = sum / sumLength;
+	float minimumDot = 1.0f;
+	for (uint32_t i = begin; i + 2 < end; i += 3)
+	{
+		glm::vec3 n = normal(i);
+		if (n != glm::vec3(0.0f))
+			minimumDot = std::min(minimumDot, glm::dot(n, axis));
+	}
+	meshlet.coneAxis = axis;
+	// normals spread over a hemisphere or more leave no direction to cull from
+	if (minimumDot > 0.0f)
+		meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+}
+
+// Cuts the mesh into meshlets and reorders its indices so each is one contiguous range; run it
+// after processMesh and before upload. Triangles face the way they are wound (counter-clockwise
+// seen from the front), which every closed generator in the scene follows.
+inline std::vector<Meshlet> buildMeshlets(IndexedMesh& mesh)
+{
+	std::vector<Meshlet> meshlets;
+	uint32_t triangleCount = (uint32_t)(mesh.indices.size() / 3);
+	uint32_t vertexCount = mesh.vertexCount();
+	auto position = [&](uint32_t v) { return glm::make_vec3(&mesh.vertices[(size_t)v * mesh.floatsPerVertex]); };
+
+	// facing of every triangle
+	std::vector<glm::vec3> normals(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		const uint32_t* triangle = &mesh.indices[t * 3];
+		glm::vec3 p0 = position(triangle[0]);
+		glm::vec3 normal = glm::cross(position(triangle[1]) - p0, position(triangle[2]) - p0);
+		float length = glm::length(normal);
+		normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+	}
+
+	// triangles around each vertex
+	std::vector<uint32_t> firstTriangle(vertexCount + 1, 0), vertexTriangles(mesh.indices.size());
+	for (uint32_t index : mesh.indices)
+		firstTriangle[index + 1]++;
+	for (uint32_t v = 0; v < vertexCount; v++)
+		firstTriangle[v + 1] += firstTriangle[v];
+	{
+		std::vector<uint32_t> cursor(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (uint32_t i = 0; i < (uint32_t)mesh.indices.size(); i++)
+			vertexTriangles[cursor[mesh.indices[i]]++] = i / 3;
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> seenBy(vertexCount, UINT32_MAX);
+	std::vector<uint32_t> order, meshletVertices;
+	order.reserve(mesh.indices.size());
+	uint32_t seed = 0;
+	while (true)
+	{
+		// seeds follow the cache-optimized order, so neighbouring meshlets stay close in the buffer
+		while (seed < triangleCount && emitted[seed])
+			seed++;
+		if (seed == triangleCount)
+			break;
+
+		uint32_t number = (uint32_t)meshlets.size();
+		Meshlet meshlet;
+		meshlet.firstIndex = (uint32_t)order.size();
+		meshletVertices.clear();
+		glm::vec3 facing(0.0f);
+		for (uint32_t next = seed; next != UINT32_MAX; )
+		{
+			emitted[next] = true;
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t v = mesh.indices[next * 3 + k];
+				order.push_back(v);
+				if (seenBy[v] != number)
+				{
+					seenBy[v] = number;
+					meshletVertices.push_back(v);
+				}
+			}
+			facing += normals[next];
+			if ((uint32_t)order.size() - meshlet.firstIndex >= MESHLET_MAX_TRIANGLES * 3)
+				break;
+
+			float facingLength = glm::length(facing);
+			glm::vec3 direction = facingLength > 0.0f ? facing / facingLength : glm::vec3(0.0f);
+			next = UINT32_MAX;
+			uint32_t bestFresh = 4;
+			float bestDot = -2.0f;
+			for (uint32_t v : meshletVertices)
+				for (uint32_t k = firstTriangle[v]; k < firstTriangle[v + 1]; k++)
+				{
+					uint32_t t = vertexTriangles[k];
+					if (emitted[t])
+						continue;
+					uint32_t fresh = 0;
+					for (int c = 0; c < 3; c++)
+						if (seenBy[mesh.indices[t * 3 + c]] != number)
+							fresh++;
+					float dot = glm::dot(normals[t], direction);
+					if (meshletVertices.size() + fresh > MESHLET_MAX_VERTICES || (facingLength > 0.0f && dot < MESHLET_MIN_NORMAL_DOT))
+						continue;
+					if (fresh < bestFresh || (fresh == bestFresh && dot > bestDot))
+					{
+						next = t;
+						bestFresh = fresh;
+						bestDot = dot;
+					}
+				}
+		}
+		meshlet.indexCount = (uint32_t)order.size() - meshlet.firstIndex;
+		meshlets.push_back(meshlet);
+	}
+	mesh.indices.swap(order);
+
+	for (Meshlet& meshlet : meshlets)
+		updateMeshletBounds(meshlet, mesh.indices.data(), position);
+	return meshlets;
+}
+
+// the camera as meshlet culling sees it, built once per frame
+struct MeshletView
+{
+	glm::vec4 planes[6];        // world space, pointing inwards
+	glm::vec3 position = glm::vec3(0.0f);
+};
+
+inline MeshletView makeMeshletView(const glm::mat4& viewProjection, const glm::vec3& cameraPosition)
+{
+	MeshletView view;
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	view.planes[0] = row[3] + row[0];
+	view.planes[1] = row[3] - row[0];
+	view.planes[2] = row[3] + row[1];
+	view.planes[3] = row[3] - row[1];
+	view.planes[4] = row[3] + row[2];
+	view.planes[5] = row[3] - row[2];
+	for (glm::vec4& plane : view.planes)
+		plane /= glm::length(glm::vec3(plane));
+	view.position = cameraPosition;
+	return view;
+}
+
+// the surviving ranges of one mesh, merged where they touch, ready for a multi-draw
+struct MeshletDrawList
+{
+	std::vector<GLsizei> counts;
+	std::vector<const void*> offsets;
+	uint32_t frustumCulled = 0;
+	uint32_t backfaceCulled = 0;
+
+	void clear()
+	{
+		counts.clear();
+		offsets.clear();
+		frustumCulled = 0;
+		backfaceCulled = 0;
+	}
+};
+
+// Culls the meshlets of a mesh drawn with `model` and appends the visible ones. indexBase is the
+// byte offset of the mesh's indices (MeshPool::indexOffset), indexSize 2 or 4. The model matrix
+// is assumed to scale uniformly, as every object in the scene does.
+inline void cullMeshlets(const std::vector<Meshlet>& meshlets, const glm::mat4& model, const MeshletView& view,
+	const void* indexBase, uint32_t indexSize, MeshletDrawList& out)
+{
+	float scale = glm::length(glm::vec3(model[0]));
+	glm::mat3 rotation = glm::mat3(model) * (scale > 0.0f ? 1.0f / scale : 1.0f);
+	uintptr_t base = (uintptr_t)indexBase;
+	uint32_t nextIndex = UINT32_MAX;
+
+	for (const Meshlet& meshlet : meshlets)
+	{
+		glm::vec3 center = glm::vec3(model * glm::vec4(meshlet.center, 1.0f));
+		float radius = meshlet.radius * scale;
+
+		bool outside = false;
+		for (const glm::vec4& plane : view.planes)
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			{
+				outside = true;
+				break;
+			}
+		if (outside)
+		{
+			out.frustumCulled++;
+			continue;
+		}
+
+		// back-facing when the camera sees every normal in the cone from behind, for any point of the sphere
+		glm::vec3 toCenter = center - view.position;
+		if (glm::dot(toCenter, rotation * meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + radius)
+		{
+			out.backfaceCulled++;
+			continue;
+		}
+
+		if (meshlet.firstIndex == nextIndex)
+			out.counts.back() += meshlet.indexCount;
+		else
+		{
+			out.counts.push_back(meshlet.indexCount);
+			out.offsets.push_back((const void*)(base + (uintptr_t)meshlet.firstIndex * indexSize));
+		}
+		nextIndex = meshlet.firstIndex + meshlet.indexCount;
+	}
+}
+#endif
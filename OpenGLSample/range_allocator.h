@@ -0,0 +1,344 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit (TLSF) allocator over the offsets [0, capacity) of some buffer.
+// It only does the bookkeeping and never touches the memory it hands out, so it has no GL
+// dependency and can be exercised on its own. Free ranges are kept in size classes: the first
+// level splits sizes by power of two, the second splits each power of two into eight linear
+// steps, and two bitmaps find a class with a fitting range in constant time. Freed ranges are
+// merged with free neighbours right away, so free space never stays split at a boundary.
+
+struct RangeAllocation
+{
+	static const uint32_t NO_NODE = 0xFFFFFFFFu;
+
+	uint32_t offset = 0;
+	uint32_t size = 0;
+	uint32_t node = NO_NODE;
+};
+
+struct RangeAllocatorStats
+{
+	uint32_t capacity = 0;
+	uint32_t usedBytes = 0;
+	uint32_t freeBytes = 0;
+	uint32_t largestFree = 0;
+	uint32_t freeRanges = 0;
+	uint32_t allocations = 0;
+
+	// 0 when all free space is one range, approaching 1 as it splinters
+	float fragmentation() const
+	{
+		return freeBytes ? 1.0f - (float)largestFree / (float)freeBytes : 0.0f;
+	}
+};
+
+class RangeAllocator
+{
+public:
+	explicit RangeAllocator(uint32_t capacity = 0)
+		: totalSize(capacity)
+	{
+		reset();
+	}
+
+	uint32_t capacity() const
+	{
+		return totalSize;
+	}
+
+	// forgets every allocation; the whole range is free again
+	void reset()
+	{
+		nodes.clear();
+		unusedNodes.clear();
+		firstLevelBitmap = 0;
+		for (uint32_t fl = 0; fl < FL_COUNT; fl++)
+		{
+			secondLevelBitmap[fl] = 0;
+			for (uint32_t sl = 0; sl < SL_COUNT; sl++)
+				freeHeads[fl][sl] = NONE;
+		}
+		freeBytes = 0;
+		allocationCount = 0;
+		if (totalSize == 0)
+			return;
+		uint32_t node = newNode(0, totalSize);
+		insertFree(node);
+	}
+
+	// finds size bytes starting at a multiple of alignment (any value, not only powers of two)
+	bool allocate(uint32_t size, uint32_t alignment, RangeAllocation& allocation)
+	{
+		if (size == 0)
+			return false;
+		if (alignment == 0)
+			alignment = 1;
+		// any range in the class found for this size fits the worst-case padding
+		uint64_t needed = (uint64_t)size + alignment - 1;
+		if (needed > totalSize)
+			return false;
+		uint32_t node = findFree((uint32_t)needed);
+		if (node == NONE)
+			return false;
+		removeFree(node);
+
+		uint32_t aligned = (nodes[node].offset + alignment - 1) / alignment * alignment;
+		uint32_t padding = aligned - nodes[node].offset;
+		if (padding > 0)
+		{
+			uint32_t rest = split(node, padding);
+			insertFree(node);
+			node = rest;
+		}
+		if (nodes[node].size > size)
+			insertFree(split(node, size));
+
+		return commit(node, allocation);
+	}
+
+	// claims exactly [offset, offset + size), which must be free; used to rebuild a compacted layout
+	bool allocateAt(uint32_t offset, uint32_t size, RangeAllocation& allocation)
+	{
+		if (size == 0 || (uint64_t)offset + size > totalSize)
+			return false;
+		for (uint32_t node = 0; node < nodes.size(); node++)
+		{
+			const Node& candidate = nodes[node];
+			if (!candidate.inUse || !candidate.free || candidate.offset > offset
+				|| (uint64_t)candidate.offset + candidate.size < (uint64_t)offset + size)
+				continue;
+			removeFree(node);
+			if (offset > nodes[node].offset)
+			{
+				uint32_t rest = split(node, offset - nodes[node].offset);
+				insertFree(node);
+				node = rest;
+			}
+			if (nodes[node].size > size)
+				insertFree(split(node, size));
+			return commit(node, allocation);
+		}
+		return false;
+	}
+
+	// returns the range and merges it with free neighbours
+	void free(const RangeAllocation& allocation)
+	{
+		uint32_t node = allocation.node;
+		if (node >= nodes.size() || !nodes[node].inUse || nodes[node].free)
+			return;
+		allocationCount--;
+
+		uint32_t previous = nodes[node].previousPhysical;
+		if (previous != NONE && nodes[previous].free)
+		{
+			removeFree(previous);
+			node = merge(previous, node);
+		}
+		uint32_t next = nodes[node].nextPhysical;
+		if (next != NONE && nodes[next].free)
+		{
+			removeFree(next);
+			node = merge(node, next);
+		}
+		insertFree(node);
+	}
+
+	RangeAllocatorStats stats() const
+	{
+		RangeAllocatorStats result;
+		result.capacity = totalSize;
+		result.freeBytes = freeBytes;
+		result.usedBytes = totalSize - freeBytes;
+		result.allocations = allocationCount;
+		for (const Node& node : nodes)
+		{
+			if (!node.inUse || !node.free)
+				continue;
+			result.freeRanges++;
+			if (node.size > result.largestFree)
+				result.largestFree = node.size;
+		}
+		return result;
+	}
+
+private:
+	enum : uint32_t { SL_BITS = 3, SL_COUNT = 1u << SL_BITS, FL_COUNT = 32 };
+	static const uint32_t NONE = 0xFFFFFFFFu;
+
+	struct Node
+	{
+		uint32_t offset = 0;
+		uint32_t size = 0;
+		uint32_t previousPhysical = NONE;
+		uint32_t nextPhysical = NONE;
+		uint32_t previousFree = NONE;
+		uint32_t nextFree = NONE;
+		bool free = false;
+		bool inUse = false;
+	};
+
+	uint32_t totalSize;
+	std::vector<Node> nodes;
+	std::vector<uint32_t> unusedNodes;
+	uint32_t firstLevelBitmap;
+	uint32_t secondLevelBitmap[FL_COUNT];
+	uint32_t freeHeads[FL_COUNT][SL_COUNT];
+	uint32_t freeBytes;
+	uint32_t allocationCount;
+
+	static uint32_t highestBit(uint32_t value)
+	{
+		uint32_t bit = 0;
+		while (value >>= 1)
+			bit++;
+		return bit;
+	}
+
+	static uint32_t lowestBit(uint32_t value)
+	{
+		uint32_t bit = 0;
+		while (!(value & 1u))
+		{
+			value >>= 1;
+			bit++;
+		}
+		return bit;
+	}
+
+	// size class holding ranges of exactly this size
+	static void mapping(uint32_t size, uint32_t& fl, uint32_t& sl)
+	{
+		if (size < SL_COUNT)
+		{
+			fl = 0;
+			sl = size;
+			return;
+		}
+		uint32_t log = highestBit(size);
+		fl = log - SL_BITS + 1;
+		sl = (size >> (log - SL_BITS)) ^ SL_COUNT;
+	}
+
+	// first free range in a class whose every member holds at least size bytes
+	uint32_t findFree(uint32_t size) const
+	{
+		uint64_t rounded = size;
+		if (size >= SL_COUNT)
+			rounded += (1ull << (highestBit(size) - SL_BITS)) - 1;
+		if (rounded > 0xFFFFFFFFull)
+			return NONE;
+		uint32_t fl, sl;
+		mapping((uint32_t)rounded, fl, sl);
+
+		uint32_t secondLevel = secondLevelBitmap[fl] & (~0u << sl);
+		if (!secondLevel)
+		{
+			uint32_t firstLevel = fl + 1 < FL_COUNT ? firstLevelBitmap & (~0u << (fl + 1)) : 0;
+			if (!firstLevel)
+				return NONE;
+			fl = lowestBit(firstLevel);
+			secondLevel = secondLevelBitmap[fl];
+		}
+		return freeHeads[fl][lowestBit(secondLevel)];
+	}
+
+	uint32_t newNode(uint32_t offset, uint32_t size)
+	{
+		uint32_t index;
+		if (!unusedNodes.empty())
+		{
+			index = unusedNodes.back();
+			unusedNodes.pop_back();
+			nodes[index] = Node();
+		}
+		else
+		{
+			index = (uint32_t)nodes.size();
+			nodes.push_back(Node());
+		}
+		nodes[index].offset = offset;
+		nodes[index].size = size;
+		nodes[index].inUse = true;
+		return index;
+	}
+
+	void insertFree(uint32_t node)
+	{
+		uint32_t fl, sl;
+		mapping(nodes[node].size, fl, sl);
+		Node& entry = nodes[node];
+		entry.free = true;
+		entry.previousFree = NONE;
+		entry.nextFree = freeHeads[fl][sl];
+		if (entry.nextFree != NONE)
+			nodes[entry.nextFree].previousFree = node;
+		freeHeads[fl][sl] = node;
+		firstLevelBitmap |= 1u << fl;
+		secondLevelBitmap[fl] |= 1u << sl;
+		freeBytes += entry.size;
+	}
+
+	void removeFree(uint32_t node)
+	{
+		uint32_t fl, sl;
+		mapping(nodes[node].size, fl, sl);
+		Node& entry = nodes[node];
+		if (entry.previousFree != NONE)
+			nodes[entry.previousFree].nextFree = entry.nextFree;
+		else
+			freeHeads[fl][sl] = entry.nextFree;
+		if (entry.nextFree != NONE)
+			nodes[entry.nextFree].previousFree = entry.previousFree;
+		if (freeHeads[fl][sl] == NONE)
+		{
+			secondLevelBitmap[fl] &= ~(1u << sl);
+			if (!secondLevelBitmap[fl])
+				firstLevelBitmap &= ~(1u << fl);
+		}
+		entry.previousFree = NONE;
+		entry.nextFree = NONE;
+		entry.free = false;
+		freeBytes -= entry.size;
+	}
+
+	// shrinks node to size and returns a new node for the remainder, right after it
+	uint32_t split(uint32_t node, uint32_t size)
+	{
+		uint32_t rest = newNode(nodes[node].offset + size, nodes[node].size - size);
+		nodes[node].size = size;
+		nodes[rest].previousPhysical = node;
+		nodes[rest].nextPhysical = nodes[node].nextPhysical;
+		if (nodes[rest].nextPhysical != NONE)
+			nodes[nodes[rest].nextPhysical].previousPhysical = rest;
+		nodes[node].nextPhysical = rest;
+		return rest;
+	}
+
+	// folds second (physically right after first) into first; neither may be on a free list
+	uint32_t merge(uint32_t first, uint32_t second)
+	{
+		nodes[first].size += nodes[second].size;
+		nodes[first].nextPhysical = nodes[second].nextPhysical;
+		if (nodes[first].nextPhysical != NONE)
+			nodes[nodes[first].nextPhysical].previousPhysical = first;
+		nodes[second].inUse = false;
+		unusedNodes.push_back(second);
+		return first;
+	}
+
+	bool commit(uint32_t node, RangeAllocation& allocation)
+	{
+		nodes[node].free = false;
+		allocationCount++;
+		allocation.offset = nodes[node].offset;
+		allocation.size = nodes[node].size;
+		allocation.node = node;
+		return true;
+	}
+};
+#endif
@@ -0,0 +1,157 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <glad/glad.h>
+
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+
+#include <iostream>
+#include <vector>
+
+// A slice of the ring handed out for this frame. ptr is where the CPU writes, offset is
+// what gets passed to glBindBufferRange / glVertexAttribPointer.
+struct RingAllocation
+{
+	void* ptr = nullptr;
+	GLintptr offset = 0;
+	GLsizeiptr size = 0;
+};
+
+// Triple-buffered stream of per-frame data (uniform blocks, dynamic vertices).
+// With GL 4.4 / ARB_buffer_storage the whole buffer is mapped once, persistently and coherently,
+// and each frame writes into its own region guarded by a fence, so the driver never reallocates
+// or stalls. Without it we fall back to orphaning a single region every frame and uploading the
+// bytes written since the last flush() with glBufferSubData.
+class RingBuffer
+{
+public:
+	unsigned int ID;
+
+	// regionSize is the most one frame may allocate; regionCount is how many frames can be in flight
+	RingBuffer(GLenum target, GLsizeiptr regionSize, unsigned int regionCount = 3)
+		: ID(0), target(target), regionSize(regionSize), regionCount(regionCount),
+		  persistent(glExt().bufferStorage), mapped(nullptr), region(0), head(0), flushed(0)
+	{
+		glGenBuffers(1, &ID);
+		glState().bindBuffer(target, ID);
+		if (persistent)
+		{
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glExt().BufferStorage(target, regionSize * regionCount, NULL, flags);
+			mapped = (unsigned char*)glMapBufferRange(target, 0, regionSize * regionCount, flags);
+			fences.assign(regionCount, (GLsync)0);
+		}
+		else
+		{
+			this->regionCount = 1;
+			glBufferData(target, regionSize, NULL, GL_STREAM_DRAW);
+			staging.resize(regionSize);
+			mapped = staging.data();
+		}
+		glState().bindBuffer(target, 0);
+		buffer = GpuResource(gpuResources().add(ResourceKind::Buffer, ID, memoryCategoryForTarget(target), regionSize * this->regionCount, "frame ring"));
+	}
+
+	// unmaps; the buffer itself is deleted by the registry once the frames reading it have finished
+	~RingBuffer()
+	{
+		for (GLsync fence : fences)
+			if (fence)
+				glDeleteSync(fence);
+		if (persistent && mapped)
+		{
+			glState().bindBuffer(target, ID);
+			glUnmapBuffer(target);
+			glState().bindBuffer(target, 0);
+		}
+	}
+
+	RingBuffer(const RingBuffer&) = delete;
+	RingBuffer& operator=(const RingBuffer&) = delete;
+
+	// moves to the next region, waiting for the GPU only if it is still reading it from regionCount frames ago
+	void beginFrame()
+	{
+		if (persistent)
+		{
+			region = (region + 1) % regionCount;
+			GLsync& fence = fences[region];
+			if (fence)
+			{
+				GLenum result = glClientWaitSync(fence, 0, 0);
+				while (result == GL_TIMEOUT_EXPIRED)
+					result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+				glDeleteSync(fence);
+				fence = (GLsync)0;
+			}
+		}
+		else
+		{
+			// orphan: the driver hands us fresh storage while last frame's draws keep the old one
+			glState().bindBuffer(target, ID);
+			glBufferData(target, regionSize, NULL, GL_STREAM_DRAW);
+			glState().bindBuffer(target, 0);
+		}
+		head = region * regionSize;
+		flushed = head;
+	}
+
+	// carves size bytes out of this frame's region; alignment must be a power of two
+	RingAllocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16)
+	{
+		RingAllocation allocation;
+		GLintptr offset = (head + alignment - 1) & ~(GLintptr)(alignment - 1);
+		if (offset + size > (region + 1) * regionSize)
+		{
+			std::cout << "ERROR::RING_BUFFER::REGION_OVERFLOW requested " << size << " bytes" << std::endl;
+			return allocation;
+		}
+		allocation.ptr = mapped + offset;
+		allocation.offset = offset;
+		allocation.size = size;
+		head = offset + size;
+		return allocation;
+	}
+
+	// makes everything written since the last flush visible to the GL; call before drawing with it.
+	// A no-op for the coherent mapping.
+	void flush()
+	{
+		if (!persistent && head > flushed)
+		{
+			glState().bindBuffer(target, ID);
+			glBufferSubData(target, flushed, head - flushed, mapped + flushed);
+			glState().bindBuffer(target, 0);
+		}
+		flushed = head;
+	}
+
+	// fences this frame's region; call once all draws reading from it have been issued
+	void endFrame()
+	{
+		flush();
+		if (persistent)
+			fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	bool isPersistent() const
+	{
+		return persistent;
+	}
+
+private:
+	GpuResource buffer;
+	GLenum target;
+	GLsizeiptr regionSize;
+	unsigned int regionCount;
+	bool persistent;
+	unsigned char* mapped;
+	std::vector<unsigned char> staging;
+	std::vector<GLsync> fences;
+	unsigned int region;
+	GLintptr head;
+	GLintptr flushed;
+};
+#endif
@@ -0,0 +1,271 @@
+#ifndef SCENE_BUFFER_H
+#define SCENE_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "block_layout.h"
+#include "dirty_ranges.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "texture_arrays.h"
+#include "vertex_layout.h"
+
+#include <cstddef>
+#include <vector>
+
+// attribute slot carrying the object index into the vertex shader
+const unsigned int OBJECT_INDEX_ATTRIBUTE = 5;
+
+// what the scene's draws submitted in a frame
+struct SceneDrawStats
+{
+	unsigned int draws = 0;
+	unsigned long long triangles = 0;
+};
+
+// One record per scene object, stored as RGBA32F texels so a vertex shader can texelFetch
+// it from a samplerBuffer (GL 3.1+), no per-draw uniforms required.
+struct ObjectRecord
+{
+	// texels 0-3: object to world
+	glm::mat4 model;
+	// texels 4-6: columns of transpose(inverse(mat3(model))), w unused
+	glm::vec4 normalMatrix[3];
+	// texel 7: x = diffuse map, y = specular map (TextureLayer::map()), z = shininess, w unused
+	glm::vec4 material;
+	// texels 8-9: vertex decode of the object's mesh; xyz = position scale / bias,
+	// positionScale.w = 1 when normals are octahedral-packed (see vertex_quantization.h)
+	glm::vec4 positionScale;
+	glm::vec4 positionBias;
+	// texel 10: part of its layer each map covers (TextureLayer::uvScale); xy = diffuse, zw = specular
+	glm::vec4 mapScale;
+};
+const int TEXELS_PER_OBJECT = sizeof(ObjectRecord) / sizeof(glm::vec4);
+
+// the record already matches std430, so it can move to a storage buffer unchanged
+using ObjectRecordGLSL = glsl::Struct<glsl::Mat4, glsl::Array<glsl::Vec4, 3>, glsl::Vec4, glsl::Vec4, glsl::Vec4, glsl::Vec4>;
+CHECK_BLOCK_SIZE(ObjectRecord, Std430, ObjectRecordGLSL);
+CHECK_BLOCK_MEMBER(ObjectRecord, Std430, ObjectRecordGLSL, 1, normalMatrix);
+CHECK_BLOCK_MEMBER(ObjectRecord, Std430, ObjectRecordGLSL, 2, material);
+CHECK_BLOCK_MEMBER(ObjectRecord, Std430, ObjectRecordGLSL, 3, positionScale);
+CHECK_BLOCK_MEMBER(ObjectRecord, Std430, ObjectRecordGLSL, 4, positionBias);
+CHECK_BLOCK_MEMBER(ObjectRecord, Std430, ObjectRecordGLSL, 5, mapScale);
+
+// Keeps every object's record resident on the GPU across frames. Edits only mark the object's
+// record in a DirtyRanges; upload() then pushes each run of dirty records with one glBufferSubData.
+// Draws tell the shader which record to read through the object index attribute: as the base
+// instance of a one-instance draw on GL 4.2+, or as a constant attribute value before that.
+class SceneBuffer
+{
+public:
+	unsigned int ID;
+	unsigned int texture;
+
+	SceneBuffer(unsigned int capacity)
+		: ID(0), texture(0), idBuffer(0), capacity(capacity),
+		  baseInstance(GLAD_GL_VERSION_4_2 != 0)
+	{
+		records.reserve(capacity);
+		recordBuffer = makeBuffer(MemoryCategory::Uniform, capacity * sizeof(ObjectRecord), NULL, GL_DYNAMIC_STORAGE_BIT, "object records");
+		ID = recordBuffer.id();
+
+		// the texture is only a view of the record buffer, so it owns no bytes of its own
+		glGenTextures(1, &texture);
+		glState().bindTexture(SCRATCH_TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, ID);
+		glState().bindTexture(SCRATCH_TEXTURE_UNIT, GL_TEXTURE_BUFFER, 0);
+		recordTexture = GpuResource(gpuResources().add(ResourceKind::Texture, texture, MemoryCategory::Texture, 0, "object records view"));
+
+		if (baseInstance)
+		{
+			// instance i of the id stream holds i, so the base instance of a draw selects the record
+			std::vector<GLuint> ids(capacity);
+			for (unsigned int i = 0; i < capacity; i++)
+				ids[i] = i;
+			idStream = makeBuffer(MemoryCategory::Vertex, capacity * sizeof(GLuint), ids.data(), 0, "object id stream");
+			idBuffer = idStream.id();
+		}
+	}
+
+	SceneBuffer(const SceneBuffer&) = delete;
+	SceneBuffer& operator=(const SceneBuffer&) = delete;
+
+	// registers an object and returns its index, or -1 once the buffer is full
+	int add(const glm::mat4& model, const TextureLayer& diffuseMap, const TextureLayer& specularMap, float shininess)
+	{
+		if (records.size() >= capacity)
+			return -1;
+		records.push_back(ObjectRecord());
+		int index = (int)records.size() - 1;
+		setTransform(index, model);
+		setMaterial(index, diffuseMap, specularMap, shininess);
+		setVertexDecode(index, VertexDecode());
+		return index;
+	}
+
+	void setTransform(int index, const glm::mat4& model)
+	{
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+		ObjectRecord& record = records[index];
+		record.model = model;
+		for (int i = 0; i < 3; i++)
+			record.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
+		markDirty(index);
+	}
+
+	// an invalid map is stored as -1, e.g. the specular map of a material packed into its diffuse map
+	void setMaterial(int index, const TextureLayer& diffuseMap, const TextureLayer& specularMap, float shininess)
+	{
+		ObjectRecord& record = records[index];
+		record.material = glm::vec4(diffuseMap.valid() ? (float)diffuseMap.map() : -1.0f,
+			specularMap.valid() ? (float)specularMap.map() : -1.0f, shininess, 0.0f);
+		record.mapScale = glm::vec4(diffuseMap.uvScale.x, diffuseMap.uvScale.y, specularMap.uvScale.x, specularMap.uvScale.y);
+		markDirty(index);
+	}
+
+	// how the shader unpacks the vertices of the mesh this object draws
+	void setVertexDecode(int index, const VertexDecode& decode)
+	{
+		ObjectRecord& record = records[index];
+		record.positionScale = glm::vec4(decode.positionScale[0], decode.positionScale[1], decode.positionScale[2], decode.octahedralNormals ? 1.0f : 0.0f);
+		record.positionBias = glm::vec4(decode.positionBias[0], decode.positionBias[1], decode.positionBias[2], 0.0f);
+		markDirty(index);
+	}
+
+	// uploads the dirty records, one call per contiguous run; a no-op on frames without edits
+	void upload()
+	{
+		if (dirty.empty())
+			return;
+		glState().bindBuffer(GL_TEXTURE_BUFFER, ID);
+		dirty.flush([this](size_t first, size_t count)
+		{
+			glBufferSubData(GL_TEXTURE_BUFFER, first * sizeof(ObjectRecord), count * sizeof(ObjectRecord), &records[first]);
+		});
+		glState().bindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	// binds the record texture to the given unit for the objectRecords samplerBuffer
+	void bind(unsigned int unit) const
+	{
+		glState().bindTexture(unit, GL_TEXTURE_BUFFER, texture);
+	}
+
+	// adds the object index stream to the currently bound VAO
+	void setupObjectIndexAttribute() const
+	{
+		if (!baseInstance)
+			return;
+		glState().bindBuffer(GL_ARRAY_BUFFER, idBuffer);
+		glVertexAttribIPointer(OBJECT_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+		glVertexAttribDivisor(OBJECT_INDEX_ATTRIBUTE, 1);
+		glEnableVertexAttribArray(OBJECT_INDEX_ATTRIBUTE);
+	}
+
+	// draws the bound VAO's indexed geometry as the given object
+	void drawElements(GLenum mode, GLsizei count, GLenum type, int object) const
+	{
+		countDraw(mode, count);
+		if (baseInstance)
+			glDrawElementsInstancedBaseInstance(mode, count, type, 0, 1, object);
+		else
+		{
+			glVertexAttribI1ui(OBJECT_INDEX_ATTRIBUTE, object);
+			glDrawElements(mode, count, type, 0);
+		}
+	}
+
+	// draws indexed geometry stored at an offset in shared buffers: indices is the byte offset of the
+	// first index, baseVertex is added to every index
+	void drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint baseVertex, int object) const
+	{
+		countDraw(mode, count);
+		if (baseInstance)
+			glDrawElementsInstancedBaseVertexBaseInstance(mode, count, type, indices, 1, baseVertex, object);
+		else
+		{
+			glVertexAttribI1ui(OBJECT_INDEX_ATTRIBUTE, object);
+			glDrawElementsBaseVertex(mode, count, type, indices, baseVertex);
+		}
+	}
+
+	// draws several index ranges of one shared-buffer mesh as the given object, e.g. the meshlets
+	// that survived culling: counts[i] indices from byte offset offsets[i], all with one base vertex
+	void multiDrawElementsBaseVertex(GLenum mode, const GLsizei* counts, GLenum type, const void* const* offsets,
+		GLsizei drawCount, GLint baseVertex, int object) const
+	{
+		if (drawCount <= 0)
+			return;
+		if (baseInstance)
+		{
+			// the object index comes from the instance, which a multi-draw cannot offset before 4.3's indirect draws
+			for (GLsizei i = 0; i < drawCount; i++)
+			{
+				countDraw(mode, counts[i]);
+				glDrawElementsInstancedBaseVertexBaseInstance(mode, counts[i], type, offsets[i], 1, baseVertex, object);
+			}
+		}
+		else
+		{
+			GLsizei total = 0;
+			for (GLsizei i = 0; i < drawCount; i++)
+				total += counts[i];
+			countDraw(mode, total);
+			baseVertices.assign((size_t)drawCount, baseVertex);
+			glVertexAttribI1ui(OBJECT_INDEX_ATTRIBUTE, object);
+			glMultiDrawElementsBaseVertex(mode, counts, type, offsets, drawCount, baseVertices.data());
+		}
+	}
+
+	// draws the bound VAO's unindexed geometry as the given object
+	void drawArrays(GLenum mode, GLint first, GLsizei count, int object) const
+	{
+		countDraw(mode, count);
+		if (baseInstance)
+			glDrawArraysInstancedBaseInstance(mode, first, count, 1, object);
+		else
+		{
+			glVertexAttribI1ui(OBJECT_INDEX_ATTRIBUTE, object);
+			glDrawArrays(mode, first, count);
+		}
+	}
+
+	// closes the current frame's counters; lastFrame() then reports them
+	void endFrame()
+	{
+		previous = current;
+		current = SceneDrawStats();
+	}
+
+	const SceneDrawStats& lastFrame() const
+	{
+		return previous;
+	}
+
+private:
+	GpuResource recordBuffer, recordTexture, idStream;
+	unsigned int idBuffer;
+	unsigned int capacity;
+	std::vector<ObjectRecord> records;
+	DirtyRanges dirty;          // in records
+	bool baseInstance;
+	mutable std::vector<GLint> baseVertices;   // multi-draw scratch, kept so draws do not allocate
+	// counted from the const draw calls
+	mutable SceneDrawStats current;
+	SceneDrawStats previous;
+
+	void countDraw(GLenum mode, GLsizei count) const
+	{
+		current.draws++;
+		if (mode == GL_TRIANGLES)
+			current.triangles += count / 3;
+	}
+
+	void markDirty(int index)
+	{
+		dirty.mark((size_t)index, 1);
+	}
+};
+#endif
@@ -5,6 +5,9 @@
 
 #include <glm/glm.hpp>
 
+#include "gl_state.h"
+#include "gpu_resources.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -14,9 +17,10 @@ class Shader
 {
 public:
 	unsigned int ID;
-	// constructor generates the shader on the fly
+	// constructor generates the shader on the fly; defines (e.g. "#define NAME\n") are inserted
+	// after the #version line of every stage, so one file can be compiled in several variants
 	// ------------------------------------------------------------------------
-	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const std::string& defines = "")
 	{
 		// 1. retrieve the vertex/fragment source code from filePath
 		std::string vertexCode;
@@ -42,8 +46,8 @@ public:
 			vShaderFile.close();
 			fShaderFile.close();
 			// convert stream into string
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
+			vertexCode = withDefines(vShaderStream.str(), defines);
+			fragmentCode = withDefines(fShaderStream.str(), defines);
 			// if geometry shader path is present, also load a geometry shader
 			if (geometryPath != nullptr)
 			{
@@ -51,7 +55,7 @@ public:
 				std::stringstream gShaderStream;
 				gShaderStream << gShaderFile.rdbuf();
 				gShaderFile.close();
-				geometryCode = gShaderStream.str();
+				geometryCode = withDefines(gShaderStream.str(), defines);
 			}
 		}
 		catch (std::ifstream::failure& e)
@@ -95,13 +99,20 @@ public:
 		glDeleteShader(fragment);
 		if (geometryPath != nullptr)
 			glDeleteShader(geometry);
-
+		program = adoptProgram(ID, vertexPath);
+	}
+	// the program is handed back to the registry, which deletes it once the GPU is done with it
+	~Shader()
+	{
+		program.reset();
 	}
+	Shader(Shader&& other) = default;
+	Shader& operator=(Shader&& other) = default;
 	// activate the shader
 	// ------------------------------------------------------------------------
 	void use()
 	{
-		glUseProgram(ID);
+		glState().useProgram(ID);
 	}
 	// utility uniform functions
 	// ------------------------------------------------------------------------
@@ -161,8 +172,29 @@ public:
 	{
 		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
 	}
+	// ------------------------------------------------------------------------
+	void setBlockBinding(const std::string &name, unsigned int binding) const
+	{
+		unsigned int index = glGetUniformBlockIndex(ID, name.c_str());
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(ID, index, binding);
+	}
 
 private:
+	GpuResource program;
+
+	// code with defines inserted after its #version line, which has to stay first
+	static std::string withDefines(const std::string& code, const std::string& defines)
+	{
+		if (defines.empty())
+			return code;
+		size_t version = code.find("#version");
+		size_t lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+		if (lineEnd == std::string::npos)
+			return defines + code;
+		return code.substr(0, lineEnd + 1) + defines + code.substr(lineEnd + 1);
+	}
+
 	// utility function for checking shader compilation/linking errors.
 	// ------------------------------------------------------------------------
 	void checkCompileErrors(GLuint shader, std::string type)
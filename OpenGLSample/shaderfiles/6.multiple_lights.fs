@@ -1,12 +1,9 @@
 #version 330 core
+// Shader prepends "#define PACKED_MATERIAL_MAPS" (Source.cpp) for materials whose specular
+// intensity is packed into the diffuse map's alpha (texture_arrays.h): the material is then read
+// with one texture() call per fragment, and either way it is read once and reused by every lamp.
 out vec4 FragColor;
 
-struct Material {
-    sampler2D diffuse;
-    sampler2D specular;
-    float shininess;
-}; 
-
 struct DirLight {
     vec3 direction;
 	
@@ -43,27 +40,62 @@ struct SpotLight {
 };
 
 #define NR_POINT_LIGHTS 4
+#define NR_MATERIAL_ARRAYS 4
+// a map is array * MAX_ARRAY_LAYERS + layer (MAX_TEXTURE_ARRAY_LAYERS in texture_arrays.h)
+#define MAX_ARRAY_LAYERS 256
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+// x = diffuse map, y = specular map (unused when packed), z = shininess (from this object's scene record)
+flat in vec3 MaterialParams;
+// part of its layer each map covers, below 1 for padded images: xy = diffuse, zw = specular
+flat in vec4 MapScale;
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
-uniform Material material;
+// per-frame camera data shared by every program (see uniform_blocks.h)
+layout (std140) uniform FrameConstants
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    float time;
+    float deltaTime;
+    vec2 resolution;
+};
+// none of these move, so they are uploaded once at startup
+layout (std140) uniform LightsBlock
+{
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+};
+// the flashlight follows the camera, so it is streamed every frame through the ring buffer
+layout (std140) uniform SpotLightBlock
+{
+    SpotLight spotLight;
+};
+uniform sampler2DArray materialArrays[NR_MATERIAL_ARRAYS];
 
 // function prototypes
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec4 SampleMap(int map, vec2 uv);
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, vec3 specularMask);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularMask);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularMask);
 
 void main()
 {    
     // properties
     vec3 norm = normalize(Normal);
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(cameraPosition.xyz - FragPos);
+#ifdef PACKED_MATERIAL_MAPS
+    // rgb = diffuse colour, a = specular intensity
+    vec4 material = SampleMap(int(MaterialParams.x), TexCoords * MapScale.xy);
+    vec3 albedo = material.rgb;
+    vec3 specularMask = vec3(material.a);
+#else
+    vec3 albedo = vec3(SampleMap(int(MaterialParams.x), TexCoords * MapScale.xy));
+    vec3 specularMask = vec3(SampleMap(int(MaterialParams.y), TexCoords * MapScale.zw));
+#endif
     
     // == =====================================================
     // Our lighting is set up in 3 phases: directional, point lights and an optional flashlight
@@ -72,48 +104,61 @@ void main()
     // this fragment's final color.
     // == =====================================================
     // phase 1: directional lighting
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
+    vec3 result = CalcDirLight(dirLight, norm, viewDir, albedo, specularMask);
     // phase 2: point lights
     for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);    
+        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir, albedo, specularMask);    
     // phase 3: spot light
-    result += CalcSpotLight(spotLight, norm, FragPos, viewDir);    
+    result += CalcSpotLight(spotLight, norm, FragPos, viewDir, albedo, specularMask);    
     
     FragColor = vec4(result, 1.0);
 }
 
+// GLSL 3.30 only allows constant indices into sampler arrays, so the object's array is resolved
+// here; the layer is just a texture coordinate. The map comes from the scene record and is
+// uniform across a draw.
+vec4 SampleMap(int map, vec2 uv)
+{
+    int array = map / MAX_ARRAY_LAYERS;
+    vec3 coords = vec3(uv, float(map - array * MAX_ARRAY_LAYERS));
+    if (array == 0) return texture(materialArrays[0], coords);
+    if (array == 1) return texture(materialArrays[1], coords);
+    if (array == 2) return texture(materialArrays[2], coords);
+    return texture(materialArrays[3], coords);
+}
+
 // calculates the color when using a directional light.
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, vec3 specularMask)
 {
     vec3 lightDir = normalize(-light.direction);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), MaterialParams.z);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularMask;
     return (ambient + diffuse + specular);
 }
 
 // calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularMask)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), MaterialParams.z);
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularMask;
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -121,14 +166,14 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 }
 
 // calculates the color when using a spot light.
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec3 specularMask)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), MaterialParams.z);
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
@@ -137,9 +182,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularMask;
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
@@ -2,20 +2,59 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in uint aObjectIndex;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+flat out vec3 MaterialParams;
+flat out vec4 MapScale;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per-object records, 11 texels each: model matrix, normal matrix, material, vertex decode, map scale (see scene_buffer.h)
+uniform samplerBuffer objectRecords;
+// per-frame camera data shared by every program (see uniform_blocks.h)
+layout (std140) uniform FrameConstants
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    float time;
+    float deltaTime;
+    vec2 resolution;
+};
+
+// unit vector from two octahedral-packed components (see vertex_quantization.h)
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    int base = int(aObjectIndex) * 11;
+    mat4 model = mat4(texelFetch(objectRecords, base),
+                      texelFetch(objectRecords, base + 1),
+                      texelFetch(objectRecords, base + 2),
+                      texelFetch(objectRecords, base + 3));
+    mat3 normalMatrix = mat3(texelFetch(objectRecords, base + 4).xyz,
+                             texelFetch(objectRecords, base + 5).xyz,
+                             texelFetch(objectRecords, base + 6).xyz);
+    MaterialParams = texelFetch(objectRecords, base + 7).xyz;
+    MapScale = texelFetch(objectRecords, base + 10);
+    // packed meshes store positions relative to their bounds and normals octahedral-encoded;
+    // float meshes have a scale of 1 and a bias of 0
+    vec4 positionScale = texelFetch(objectRecords, base + 8);
+    vec3 positionBias = texelFetch(objectRecords, base + 9).xyz;
+    vec3 position = aPos * positionScale.xyz + positionBias;
+    vec3 normal = positionScale.w > 0.5 ? octahedralDecode(aNormal.xy) : aNormal;
+
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = normalMatrix * normal;
     TexCoords = aTexCoords;
     
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,218 @@
+#ifndef TANGENT_SPACE_H
+#define TANGENT_SPACE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "mesh_processing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Per-vertex tangent frames for normal mapping, following MikkTSpace's conventions so maps baked
+// by the usual tools come out right:
+//   - each face's tangent points along increasing u; its orientation is the sign of the UV area
+//   - at every corner the face tangent is projected into the vertex normal's tangent plane and
+//     weighted by the corner angle before it is summed into the vertex
+//   - faces of opposite orientation never share a tangent: a vertex used by both is split in two
+//   - the bitangent is not summed but rebuilt as sign * cross(normal, tangent)
+// Faces with degenerate UVs contribute nothing; a vertex left with no tangent gets any direction
+// perpendicular to its normal. The per-face and per-vertex passes run on several threads for
+// large meshes.
+
+// float offsets of the attributes within one vertex; the defaults match mesh.h's Vertex
+struct TangentLayout
+{
+	uint32_t position = 0;
+	uint32_t normal = 3;
+	uint32_t uv = 6;
+	uint32_t tangent = 8;
+	uint32_t bitangent = 11;
+};
+
+// meshes with at least this many triangles are processed on several threads
+const uint32_t PARALLEL_TANGENT_TRIANGLES = 1 << 14;
+
+// calls batch(first, end) over [0, count), split over the hardware threads when parallel is set
+template <typename Batch>
+inline void forEachTangentBatch(uint32_t count, bool parallel, Batch batch)
+{
+	unsigned int workers = parallel ? std::max(1u, std::min(std::thread::hardware_concurrency(), count)) : 1;
+	if (workers <= 1)
+	{
+		batch(0u, count);
+		return;
+	}
+
+	uint32_t chunk = (count + workers - 1) / workers;
+	std::vector<std::thread> threads;
+	for (uint32_t first = chunk; first < count; first += chunk)
+		threads.emplace_back(batch, first, std::min(count, first + chunk));
+	batch(0u, std::min(count, chunk));
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+// any unit vector perpendicular to n
+inline glm::vec3 anyTangent(const glm::vec3& n)
+{
+	glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::vec3 t = axis - n * glm::dot(n, axis);
+	float length = glm::length(t);
+	return length > 0.0f ? t / length : glm::vec3(1.0f, 0.0f, 0.0f);
+}
+
+// Fills the tangent and bitangent of every vertex. Vertices shared by faces of opposite UV
+// orientation are duplicated at the end of the vertex array and their indices rewritten, so
+// run it after processMesh (welding would otherwise undo the split) and before meshlets.
+inline void generateTangents(IndexedMesh& mesh, const TangentLayout& layout = TangentLayout())
+{
+	const uint32_t stride = mesh.floatsPerVertex;
+	const uint32_t vertexCount = mesh.vertexCount();
+	const uint32_t indexCount = (uint32_t)mesh.indices.size();
+	const uint32_t triangleCount = indexCount / 3;
+	const bool parallel = triangleCount >= PARALLEL_TANGENT_TRIANGLES;
+	auto attribute = [&](uint32_t v, uint32_t offset) { return &mesh.vertices[(size_t)v * stride + offset]; };
+
+	// faces: orientation, and each corner's angle-weighted contribution in its vertex's tangent plane
+	enum : uint8_t { DEGENERATE = 0, POSITIVE = 1, NEGATIVE = 2 };
+	std::vector<uint8_t> orientation(triangleCount, DEGENERATE);
+	std::vector<glm::vec3> cornerTangents(indexCount, glm::vec3(0.0f));
+	forEachTangentBatch(triangleCount, parallel, [&](uint32_t first, uint32_t end)
+	{
+		for (uint32_t t = first; t < end; t++)
+		{
+			const uint32_t* triangle = &mesh.indices[t * 3];
+			glm::vec3 p[3];
+			glm::vec2 uv[3];
+			for (int k = 0; k < 3; k++)
+			{
+				p[k] = glm::make_vec3(attribute(triangle[k], layout.position));
+				uv[k] = glm::make_vec2(attribute(triangle[k], layout.uv));
+			}
+			glm::vec3 e1 = p[1] - p[0], e2 = p[2] - p[0];
+			glm::vec2 s1 = uv[1] - uv[0], s2 = uv[2] - uv[0];
+			float area = s1.x * s2.y - s2.x * s1.y;
+			if (std::fabs(area) <= 1e-12f)
+				continue;
+			// along increasing u whichever way the UVs are wound
+			glm::vec3 faceTangent = (e1 * s2.y - e2 * s1.y) * (area > 0.0f ? 1.0f : -1.0f);
+			if (glm::length(faceTangent) <= 0.0f)
+				continue;
+			orientation[t] = area > 0.0f ? POSITIVE : NEGATIVE;
+
+			for (int k = 0; k < 3; k++)
+			{
+				glm::vec3 n = glm::make_vec3(attribute(triangle[k], layout.normal));
+				glm::vec3 projected = faceTangent - n * glm::dot(n, faceTangent);
+				float length = glm::length(projected);
+				glm::vec3 a = p[(k + 1) % 3] - p[k], b = p[(k + 2) % 3] - p[k];
+				float lengths = glm::length(a) * glm::length(b);
+				if (length <= 0.0f || lengths <= 0.0f)
+					continue;
+				float angle = std::acos(std::max(-1.0f, std::min(1.0f, glm::dot(a, b) / lengths)));
+				cornerTangents[t * 3 + k] = projected * (angle / length);
+			}
+		}
+	});
+
+	// corners around each vertex
+	std::vector<uint32_t> firstCorner(vertexCount + 1, 0), vertexCorners(indexCount);
+	for (uint32_t index : mesh.indices)
+		firstCorner[index + 1]++;
+	for (uint32_t v = 0; v < vertexCount; v++)
+		firstCorner[v + 1] += firstCorner[v];
+	{
+		std::vector<uint32_t> cursor(firstCorner.begin(), firstCorner.end() - 1);
+		for (uint32_t i = 0; i < indexCount; i++)
+			vertexCorners[cursor[mesh.indices[i]]++] = i;
+	}
+
+	// vertices: sum each orientation separately; the negative sum of a vertex used both ways goes to its split copy
+	auto writeFrame = [&](uint32_t v, glm::vec3 sum, float sign)
+	{
+		glm::vec3 n = glm::make_vec3(attribute(v, layout.normal));
+		glm::vec3 t = sum - n * glm::dot(n, sum);
+		float length = glm::length(t);
+		t = length > 1e-12f ? t / length : anyTangent(n);
+		glm::vec3 b = glm::cross(n, t) * sign;
+		float* tangent = attribute(v, layout.tangent);
+		float* bitangent = attribute(v, layout.bitangent);
+		for (int c = 0; c < 3; c++)
+		{
+			tangent[c] = t[c];
+			bitangent[c] = b[c];
+		}
+	};
+	std::vector<glm::vec3> splitTangents(vertexCount, glm::vec3(0.0f));
+	std::vector<uint8_t> split(vertexCount, 0);
+	forEachTangentBatch(vertexCount, parallel, [&](uint32_t first, uint32_t end)
+	{
+		for (uint32_t v = first; v < end; v++)
+		{
+			glm::vec3 positive(0.0f), negative(0.0f);
+			bool usedPositive = false, usedNegative = false;
+			for (uint32_t k = firstCorner[v]; k < firstCorner[v + 1]; k++)
+			{
+				uint32_t corner = vertexCorners[k];
+				if (orientation[corner / 3] == POSITIVE)
+				{
+					positive += cornerTangents[corner];
+					usedPositive = true;
+				}
+				else if (orientation[corner / 3] == NEGATIVE)
+				{
+					negative += cornerTangents[corner];
+					usedNegative = true;
+				}
+			}
+			if (usedPositive && usedNegative)
+			{
+				split[v] = 1;
+				splitTangents[v] = negative;
+			}
+			if (usedPositive || !usedNegative)
+				writeFrame(v, positive, 1.0f);
+			else
+				writeFrame(v, negative, -1.0f);
+		}
+	});
+
+	// the split copies, with the negative faces pointed at them
+	std::vector<uint32_t> copyOf(vertexCount, 0);
+	uint32_t copies = 0;
+	for (uint32_t v = 0; v < vertexCount; v++)
+		if (split[v])
+			copyOf[v] = vertexCount + copies++;
+	if (copies == 0)
+		return;
+	mesh.vertices.resize((size_t)(vertexCount + copies) * stride);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		if (!split[v])
+			continue;
+		std::copy_n(attribute(v, 0), stride, attribute(copyOf[v], 0));
+		writeFrame(copyOf[v], splitTangents[v], -1.0f);
+	}
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+		if (orientation[i / 3] == NEGATIVE && split[mesh.indices[i]])
+			mesh.indices[i] = copyOf[mesh.indices[i]];
+}
+
+// the mesh with room for a tangent and bitangent after every vertex's existing floats, e.g.
+// 8-float position/normal/uv vertices become 14 floats laid out like mesh.h's Vertex
+inline IndexedMesh appendTangentSlots(const IndexedMesh& mesh)
+{
+	IndexedMesh widened;
+	widened.floatsPerVertex = mesh.floatsPerVertex + 6;
+	widened.indices = mesh.indices;
+	widened.vertices.assign((size_t)mesh.vertexCount() * widened.floatsPerVertex, 0.0f);
+	for (uint32_t v = 0; v < mesh.vertexCount(); v++)
+		std::copy(mesh.vertices.begin() + (size_t)v * mesh.floatsPerVertex, mesh.vertices.begin() + (size_t)(v + 1) * mesh.floatsPerVertex,
+			widened.vertices.begin() + (size_t)v * widened.floatsPerVertex);
+	return widened;
+}
+#endif
@@ -0,0 +1,391 @@
+#ifndef TEXTURE_ARRAYS_H
+#define TEXTURE_ARRAYS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Packs the material textures into GL_TEXTURE_2D_ARRAY objects, so a shader picks a texture by
+// layer instead of the program switching texture bindings between objects. Images with the same
+// channel count and size share an array. What happens to images whose sizes differ is set by
+// TexturePackOptions:
+//   - Exact: only images of exactly the same size share an array
+//   - Resize: every image is resampled to the array's size; UVs are unchanged. Unless a size is
+//     given the array takes the smallest width and height among its images, so no image is
+//     scaled up and the array never holds more texels than the images it was packed from
+//   - Pad: every image keeps its pixels and sits in the top-left corner of its layer, its last
+//     row and column repeated to the edges; the layer's uvScale maps [0, 1] UVs onto the image.
+//     SceneBuffer keeps it in the object's record and the lighting shader scales the UVs by it.
+//     GL_REPEAT then tiles the whole layer, padding included, so only use it for maps that are
+//     not tiled. Unless a size is given the array takes the largest, so every image fits
+// Every image is addressed as a TextureLayer (array, layer) once pack() has run. A scene record
+// stores it as the single number map(), which the shader splits back into the two, and its uvScale.
+//
+// A diffuse map can also be queued together with its specular map: the specular intensity is
+// stored in the diffuse layer's alpha, so one RGBA texel holds the whole material and one
+// texture() call per fragment reads it (PACKED_MATERIAL_MAPS in 6.multiple_lights.fs).
+
+enum class TexturePackMode { Exact, Resize, Pad };
+
+struct TexturePackOptions
+{
+	TexturePackMode mode = TexturePackMode::Resize;
+	int width = 0;      // layer size of every array; 0 picks it from the array's images (see above)
+	int height = 0;
+	bool mipmapped = true;
+	GLint wrap = GL_REPEAT;
+};
+
+// layers per array; GL 3.3 guarantees at least 256, so map() never runs into the next array
+const int MAX_TEXTURE_ARRAY_LAYERS = 256;
+
+struct TextureLayer
+{
+	int array = -1;
+	int layer = 0;
+	glm::vec2 uvScale = glm::vec2(1.0f);   // part of the layer the image covers; below 1 only when padded
+
+	bool valid() const
+	{
+		return array >= 0;
+	}
+
+	// the one number a scene record keeps for this texture
+	int map() const
+	{
+		return array * MAX_TEXTURE_ARRAY_LAYERS + layer;
+	}
+};
+
+// 8-bit pixels in memory, rows tightly packed
+struct TextureImage
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::vector<unsigned char> pixels;
+};
+
+// pixel format and sized internal format for 8-bit images of 1 to 4 channels
+inline void textureFormatsFor(int channels, GLenum& format, GLenum& internalFormat)
+{
+	switch (channels)
+	{
+	case 1: format = GL_RED; internalFormat = GL_R8; break;
+	case 2: format = GL_RG; internalFormat = GL_RG8; break;
+	case 3: format = GL_RGB; internalFormat = GL_RGB8; break;
+	default: format = GL_RGBA; internalFormat = GL_RGBA8; break;
+	}
+}
+
+// reads an image file into memory; false, with the image untouched, if it cannot be read
+inline bool loadTextureImage(const std::string& path, TextureImage& image)
+{
+	int width, height, channels;
+	unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+	if (!data)
+	{
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+		return false;
+	}
+	image.width = width;
+	image.height = height;
+	image.channels = channels;
+	image.pixels.assign(data, data + (size_t)width * height * channels);
+	stbi_image_free(data);
+	return true;
+}
+
+// bilinear resample with texel centres lined up, so the image is neither shifted nor cropped
+inline TextureImage resizeTextureImage(const TextureImage& image, int width, int height)
+{
+	TextureImage resized;
+	resized.width = width;
+	resized.height = height;
+	resized.channels = image.channels;
+	resized.pixels.resize((size_t)width * height * image.channels);
+	const int channels = image.channels;
+	float scaleX = (float)image.width / (float)width, scaleY = (float)image.height / (float)height;
+	for (int y = 0; y < height; y++)
+	{
+		float sourceY = std::max(0.0f, ((float)y + 0.5f) * scaleY - 0.5f);
+		int y0 = std::min((int)sourceY, image.height - 1), y1 = std::min(y0 + 1, image.height - 1);
+		float fy = sourceY - (float)y0;
+		for (int x = 0; x < width; x++)
+		{
+			float sourceX = std::max(0.0f, ((float)x + 0.5f) * scaleX - 0.5f);
+			int x0 = std::min((int)sourceX, image.width - 1), x1 = std::min(x0 + 1, image.width - 1);
+			float fx = sourceX - (float)x0;
+			const unsigned char* p00 = &image.pixels[((size_t)y0 * image.width + x0) * channels];
+			const unsigned char* p01 = &image.pixels[((size_t)y0 * image.width + x1) * channels];
+			const unsigned char* p10 = &image.pixels[((size_t)y1 * image.width + x0) * channels];
+			const unsigned char* p11 = &image.pixels[((size_t)y1 * image.width + x1) * channels];
+			unsigned char* out = &resized.pixels[((size_t)y * width + x) * channels];
+			for (int c = 0; c < channels; c++)
+			{
+				float top = p00[c] + (p01[c] - p00[c]) * fx;
+				float bottom = p10[c] + (p11[c] - p10[c]) * fx;
+				out[c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+			}
+		}
+	}
+	return resized;
+}
+
+// the image in the top-left corner of width x height, its last column and row repeated out to
+// the edges so mip levels and filtering at the border do not pull in black
+inline TextureImage padTextureImage(const TextureImage& image, int width, int height)
+{
+	TextureImage padded;
+	padded.width = width;
+	padded.height = height;
+	padded.channels = image.channels;
+	padded.pixels.resize((size_t)width * height * image.channels);
+	const size_t texel = (size_t)image.channels;
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* row = &image.pixels[(size_t)std::min(y, image.height - 1) * image.width * texel];
+		unsigned char* out = &padded.pixels[(size_t)y * width * texel];
+		std::copy(row, row + (size_t)image.width * texel, out);
+		for (int x = image.width; x < width; x++)
+			std::copy(row + (size_t)(image.width - 1) * texel, row + (size_t)image.width * texel, out + (size_t)x * texel);
+	}
+	return padded;
+}
+
+// The diffuse colour in rgb and the specular intensity in alpha. A coloured specular map is
+// reduced to its luma, which is all the lighting uses once it is a single channel; one of a
+// different size is resampled to the diffuse map's.
+inline TextureImage packSpecularIntoAlpha(const TextureImage& diffuse, const TextureImage& specular)
+{
+	TextureImage resized;
+	if (specular.width != diffuse.width || specular.height != diffuse.height)
+		resized = resizeTextureImage(specular, diffuse.width, diffuse.height);
+	const TextureImage& source = resized.pixels.empty() ? specular : resized;
+	TextureImage packed;
+	packed.width = diffuse.width;
+	packed.height = diffuse.height;
+	packed.channels = 4;
+	packed.pixels.resize((size_t)diffuse.width * diffuse.height * 4);
+	for (size_t texel = 0; texel < (size_t)diffuse.width * diffuse.height; texel++)
+	{
+		const unsigned char* colour = &diffuse.pixels[texel * diffuse.channels];
+		const unsigned char* intensity = &source.pixels[texel * source.channels];
+		unsigned char* out = &packed.pixels[texel * 4];
+		// grey and grey-alpha images repeat their first channel
+		for (int c = 0; c < 3; c++)
+			out[c] = colour[diffuse.channels >= 3 ? c : 0];
+		out[3] = source.channels >= 3
+			? (unsigned char)(0.299f * intensity[0] + 0.587f * intensity[1] + 0.114f * intensity[2] + 0.5f)
+			: intensity[0];
+	}
+	return packed;
+}
+
+class TexturePacker
+{
+public:
+	explicit TexturePacker(const TexturePackOptions& options = TexturePackOptions())
+		: options(options)
+	{
+	}
+
+	// Queues the image file at path and returns its number for layer(); the same path queued
+	// twice is one image. -1 if it cannot be read.
+	int add(const std::string& path)
+	{
+		for (size_t i = 0; i < images.size(); i++)
+			if (images[i].label == path)
+				return (int)i;
+		const TextureImage* image = decode(path);
+		if (!image)
+			return -1;
+		return add(*image, path);
+	}
+
+	// queues a diffuse map with the specular map's intensity in its alpha; the same pair twice is one image
+	int add(const std::string& diffusePath, const std::string& specularPath)
+	{
+		std::string label = diffusePath + " + " + specularPath;
+		for (size_t i = 0; i < images.size(); i++)
+			if (images[i].label == label)
+				return (int)i;
+		const TextureImage* diffuse = decode(diffusePath);
+		const TextureImage* specular = decode(specularPath);
+		if (!diffuse || !specular)
+			return -1;
+		return add(packSpecularIntoAlpha(*diffuse, *specular), label);
+	}
+
+	// queues an image already in memory
+	int add(TextureImage image, const std::string& label)
+	{
+		if (packed)
+		{
+			std::cout << "ERROR::TEXTURE_PACKER::ALREADY_PACKED " << label << " was added after pack()" << std::endl;
+			return -1;
+		}
+		Entry entry;
+		entry.image = std::move(image);
+		entry.label = label;
+		images.push_back(std::move(entry));
+		return (int)images.size() - 1;
+	}
+
+	// Sorts the queued images into arrays and uploads them. The CPU copies are freed afterwards.
+	void pack()
+	{
+		if (packed)
+			return;
+		packed = true;
+		decoded.clear();
+
+		// arrays in the order their first image was queued
+		std::vector<std::vector<size_t> > groups;
+		std::vector<std::pair<int, int> > sizes;        // largest width and height of each array
+		std::vector<std::pair<int, int> > smallest;
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			const TextureImage& image = images[i].image;
+			size_t group = 0;
+			while (group < groups.size() && !(images[groups[group][0]].image.channels == image.channels
+				&& groups[group].size() < (size_t)MAX_TEXTURE_ARRAY_LAYERS
+				&& (options.mode != TexturePackMode::Exact || sizes[group] == std::make_pair(image.width, image.height))))
+				group++;
+			if (group == groups.size())
+			{
+				groups.push_back(std::vector<size_t>());
+				sizes.push_back(std::make_pair(0, 0));
+				smallest.push_back(std::make_pair(image.width, image.height));
+			}
+			groups[group].push_back(i);
+			sizes[group].first = std::max(sizes[group].first, image.width);
+			sizes[group].second = std::max(sizes[group].second, image.height);
+			smallest[group].first = std::min(smallest[group].first, image.width);
+			smallest[group].second = std::min(smallest[group].second, image.height);
+		}
+
+		for (size_t group = 0; group < groups.size(); group++)
+		{
+			int width = sizes[group].first, height = sizes[group].second;
+			if (options.mode == TexturePackMode::Resize)
+			{
+				width = smallest[group].first;
+				height = smallest[group].second;
+			}
+			if (options.mode != TexturePackMode::Exact && options.width > 0 && options.height > 0)
+			{
+				width = options.width;
+				height = options.height;
+			}
+
+			std::vector<const void*> layerPixels;
+			std::string label = "texture array:";
+			for (size_t layer = 0; layer < groups[group].size(); layer++)
+			{
+				Entry& entry = images[groups[group][layer]];
+				fit(entry, width, height);
+				entry.layer.array = (int)arrays.size();
+				entry.layer.layer = (int)layer;
+				layerPixels.push_back(entry.image.pixels.data());
+				label += " " + entry.label;
+			}
+
+			GLenum format, internalFormat;
+			textureFormatsFor(images[groups[group][0]].image.channels, format, internalFormat);
+			// rows of 1-3 channel images are not 4-byte aligned in general
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			arrays.push_back(makeTextureArray(width, height, (GLsizei)layerPixels.size(), internalFormat, format, GL_UNSIGNED_BYTE,
+				layerPixels.data(), options.mipmapped, options.wrap, label));
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+			for (size_t i : groups[group])
+				images[i].image = TextureImage();
+		}
+	}
+
+	// where image number `image` ended up; invalid before pack() or for an image that failed to load
+	TextureLayer layer(int image) const
+	{
+		if (!packed || image < 0 || image >= (int)images.size())
+			return TextureLayer();
+		return images[image].layer;
+	}
+
+	size_t arrayCount() const
+	{
+		return arrays.size();
+	}
+
+	GLuint array(size_t index) const
+	{
+		return index < arrays.size() ? arrays[index].id() : 0;
+	}
+
+	// binds array i to unit firstUnit + i
+	void bind(GLuint firstUnit) const
+	{
+		for (size_t i = 0; i < arrays.size(); i++)
+			glState().bindTexture(firstUnit + (GLuint)i, GL_TEXTURE_2D_ARRAY, arrays[i].id());
+	}
+
+private:
+	struct Entry
+	{
+		TextureImage image;
+		std::string label;
+		TextureLayer layer;
+	};
+
+	// Decodes the file at path the first time it is asked for and keeps it until pack(), so a map
+	// used by several materials, like a shared specular map, is read once. A file that cannot be
+	// read is remembered as such and reported once.
+	const TextureImage* decode(const std::string& path)
+	{
+		auto found = decoded.find(path);
+		if (found == decoded.end())
+		{
+			TextureImage image;
+			loadTextureImage(path, image);
+			found = decoded.emplace(path, std::move(image)).first;
+		}
+		return found->second.pixels.empty() ? nullptr : &found->second;
+	}
+
+	// brings an image to the array's size the way the options ask
+	void fit(Entry& entry, int width, int height)
+	{
+		TextureImage& image = entry.image;
+		if (image.width == width && image.height == height)
+			return;
+		if (options.mode == TexturePackMode::Pad)
+		{
+			// an image larger than the layer is shrunk to fit first
+			if (image.width > width || image.height > height)
+				image = resizeTextureImage(image, std::min(image.width, width), std::min(image.height, height));
+			entry.layer.uvScale = glm::vec2((float)image.width / (float)width, (float)image.height / (float)height);
+			image = padTextureImage(image, width, height);
+		}
+		else
+			image = resizeTextureImage(image, width, height);
+	}
+
+	TexturePackOptions options;
+	std::vector<Entry> images;
+	std::map<std::string, TextureImage> decoded;
+	std::vector<GpuResource> arrays;
+	bool packed = false;
+};
+#endif
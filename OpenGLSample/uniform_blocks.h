@@ -0,0 +1,100 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glm/glm.hpp>
+
+#include "block_layout.h"
+
+// Binding points and C++ mirrors of the std140 uniform blocks declared in shaderfiles/.
+// Each program maps its blocks to these points once with Shader::setBlockBinding.
+// Every mirror is checked member by member against its GLSL declaration, so they can be
+// memcpy'd straight into mapped buffers.
+
+const unsigned int FRAME_CONSTANTS_BINDING = 0;
+const unsigned int SPOTLIGHT_BINDING = 1;
+const unsigned int LIGHTS_BINDING = 2;
+
+const int NR_POINT_LIGHTS = 4;
+
+// camera and timing data shared by every program, uploaded once per frame
+struct FrameConstants
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 cameraPosition; // w unused
+	float time;
+	float deltaTime;
+	glm::vec2 resolution;
+};
+using FrameConstantsGLSL = glsl::Struct<glsl::Mat4, glsl::Mat4, glsl::Mat4, glsl::Vec4, glsl::Float, glsl::Float, glsl::Vec2>;
+CHECK_BLOCK_SIZE(FrameConstants, Std140, FrameConstantsGLSL);
+CHECK_BLOCK_MEMBER(FrameConstants, Std140, FrameConstantsGLSL, 3, cameraPosition);
+CHECK_BLOCK_MEMBER(FrameConstants, Std140, FrameConstantsGLSL, 4, time);
+CHECK_BLOCK_MEMBER(FrameConstants, Std140, FrameConstantsGLSL, 6, resolution);
+
+// mirror of DirLight in 6.multiple_lights.fs
+struct DirLightData
+{
+	glm::vec3 direction; float pad0;
+	glm::vec3 ambient;   float pad1;
+	glm::vec3 diffuse;   float pad2;
+	glm::vec3 specular;  float pad3;
+};
+using DirLightGLSL = glsl::Struct<glsl::Vec3, glsl::Vec3, glsl::Vec3, glsl::Vec3>;
+CHECK_BLOCK_SIZE(DirLightData, Std140, DirLightGLSL);
+CHECK_BLOCK_MEMBER(DirLightData, Std140, DirLightGLSL, 1, ambient);
+CHECK_BLOCK_MEMBER(DirLightData, Std140, DirLightGLSL, 2, diffuse);
+CHECK_BLOCK_MEMBER(DirLightData, Std140, DirLightGLSL, 3, specular);
+
+// mirror of PointLight in 6.multiple_lights.fs
+struct PointLightData
+{
+	glm::vec3 position;  float constant;
+	float linear;        float quadratic; float pad0[2];
+	glm::vec3 ambient;   float pad1;
+	glm::vec3 diffuse;   float pad2;
+	glm::vec3 specular;  float pad3;
+};
+using PointLightGLSL = glsl::Struct<glsl::Vec3, glsl::Float, glsl::Float, glsl::Float, glsl::Vec3, glsl::Vec3, glsl::Vec3>;
+CHECK_BLOCK_SIZE(PointLightData, Std140, PointLightGLSL);
+CHECK_BLOCK_MEMBER(PointLightData, Std140, PointLightGLSL, 1, constant);
+CHECK_BLOCK_MEMBER(PointLightData, Std140, PointLightGLSL, 2, linear);
+CHECK_BLOCK_MEMBER(PointLightData, Std140, PointLightGLSL, 3, quadratic);
+CHECK_BLOCK_MEMBER(PointLightData, Std140, PointLightGLSL, 4, ambient);
+CHECK_BLOCK_MEMBER(PointLightData, Std140, PointLightGLSL, 5, diffuse);
+CHECK_BLOCK_MEMBER(PointLightData, Std140, PointLightGLSL, 6, specular);
+
+// mirror of SpotLight in 6.multiple_lights.fs
+struct SpotLightBlock
+{
+	glm::vec3 position;  float pad0;
+	glm::vec3 direction; float cutOff;
+	float outerCutOff;   float constant; float linear; float quadratic;
+	glm::vec3 ambient;   float pad1;
+	glm::vec3 diffuse;   float pad2;
+	glm::vec3 specular;  float pad3;
+};
+using SpotLightGLSL = glsl::Struct<glsl::Vec3, glsl::Vec3, glsl::Float, glsl::Float, glsl::Float, glsl::Float, glsl::Float, glsl::Vec3, glsl::Vec3, glsl::Vec3>;
+CHECK_BLOCK_SIZE(SpotLightBlock, Std140, SpotLightGLSL);
+CHECK_BLOCK_MEMBER(SpotLightBlock, Std140, SpotLightGLSL, 1, direction);
+CHECK_BLOCK_MEMBER(SpotLightBlock, Std140, SpotLightGLSL, 2, cutOff);
+CHECK_BLOCK_MEMBER(SpotLightBlock, Std140, SpotLightGLSL, 3, outerCutOff);
+CHECK_BLOCK_MEMBER(SpotLightBlock, Std140, SpotLightGLSL, 4, constant);
+CHECK_BLOCK_MEMBER(SpotLightBlock, Std140, SpotLightGLSL, 5, linear);
+CHECK_BLOCK_MEMBER(SpotLightBlock, Std140, SpotLightGLSL, 6, quadratic);
+CHECK_BLOCK_MEMBER(SpotLightBlock, Std140, SpotLightGLSL, 7, ambient);
+CHECK_BLOCK_MEMBER(SpotLightBlock, Std140, SpotLightGLSL, 8, diffuse);
+CHECK_BLOCK_MEMBER(SpotLightBlock, Std140, SpotLightGLSL, 9, specular);
+
+// the static lights: uploaded once at startup since none of them move
+struct LightsBlock
+{
+	DirLightData dirLight;
+	PointLightData pointLights[NR_POINT_LIGHTS];
+};
+using LightsGLSL = glsl::Struct<DirLightGLSL, glsl::Array<PointLightGLSL, NR_POINT_LIGHTS>>;
+CHECK_BLOCK_SIZE(LightsBlock, Std140, LightsGLSL);
+CHECK_BLOCK_MEMBER(LightsBlock, Std140, LightsGLSL, 1, pointLights);
+static_assert(sizeof(PointLightData) == Layout<Std140, glsl::Array<PointLightGLSL, NR_POINT_LIGHTS>>::stride, "PointLightData does not match the GLSL array stride");
+#endif
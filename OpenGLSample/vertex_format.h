@@ -0,0 +1,186 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+#include "vertex_layout.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// Vertex formats declared as compile-time lists of attributes. A format works out its own
+// stride and offsets and builds the VertexLayout / glVertexAttribPointer calls from them, so a
+// layout is written once as a type instead of as hand-counted byte offsets:
+//
+//   using LitVertex = VertexFormat<Position3f, Normal3f, TexCoord2f>;
+//   static_assert(LitVertex::stride == 8 * sizeof(float), "");
+//   LitVertex::setup();   // attribute pointers for the buffer bound to GL_ARRAY_BUFFER
+//
+// VertexStreams splits a vertex over several buffers, one format each. Putting the position
+// alone in the first stream lets depth and shadow passes use a VAO that fetches positions only.
+
+// bits of an IEEE half float, for half-float attributes
+struct Half
+{
+	uint16_t bits;
+};
+
+template <typename Component> struct GLTypeOf;
+template <> struct GLTypeOf<float> { static const GLenum value = GL_FLOAT; };
+template <> struct GLTypeOf<Half> { static const GLenum value = GL_HALF_FLOAT; };
+template <> struct GLTypeOf<int8_t> { static const GLenum value = GL_BYTE; };
+template <> struct GLTypeOf<uint8_t> { static const GLenum value = GL_UNSIGNED_BYTE; };
+template <> struct GLTypeOf<int16_t> { static const GLenum value = GL_SHORT; };
+template <> struct GLTypeOf<uint16_t> { static const GLenum value = GL_UNSIGNED_SHORT; };
+template <> struct GLTypeOf<int32_t> { static const GLenum value = GL_INT; };
+template <> struct GLTypeOf<uint32_t> { static const GLenum value = GL_UNSIGNED_INT; };
+
+// one attribute: shader location, component type and count; Normalized maps integers to [0, 1] / [-1, 1]
+template <GLuint Location, typename Component, GLint Components, GLboolean Normalized = GL_FALSE>
+struct Attribute
+{
+	static const bool padding = false;
+	static const GLuint location = Location;
+	static const GLint components = Components;
+	static const GLenum type = GLTypeOf<Component>::value;
+	static const GLboolean normalized = Normalized;
+	static const GLuint size = sizeof(Component) * Components;
+};
+
+// bytes of the vertex that this format does not read, e.g. to view only part of an interleaved buffer
+template <GLuint Bytes>
+struct Padding
+{
+	static const bool padding = true;
+	static const GLuint location = 0;
+	static const GLuint size = Bytes;
+};
+
+// the attribute locations every shader in the project uses
+using Position3f = Attribute<0, float, 3>;
+using Normal3f = Attribute<1, float, 3>;
+using TexCoord2f = Attribute<2, float, 2>;
+using Tangent3f = Attribute<3, float, 3>;
+using Bitangent3f = Attribute<4, float, 3>;
+
+// points the layout's attributes at the buffer bound to GL_ARRAY_BUFFER, in the bound VAO
+inline void setupVertexAttributes(const VertexLayout& layout, GLuint baseOffset = 0)
+{
+	for (const VertexAttribute& attribute : layout.attributes)
+	{
+		glVertexAttribPointer(attribute.index, attribute.components, attribute.type, attribute.normalized,
+			layout.stride, (void*)(uintptr_t)(baseOffset + attribute.offset));
+		glEnableVertexAttribArray(attribute.index);
+	}
+}
+
+template <typename... Attributes> struct VertexFormat;
+
+template <>
+struct VertexFormat<>
+{
+	static const GLsizei stride = 0;
+
+	template <GLuint Location>
+	static constexpr bool has()
+	{
+		return false;
+	}
+
+	template <GLuint Location>
+	static constexpr GLuint offsetOf()
+	{
+		return 0;
+	}
+
+	static void appendAttributes(std::vector<VertexAttribute>&, GLuint)
+	{
+	}
+};
+
+template <typename First, typename... Rest>
+struct VertexFormat<First, Rest...>
+{
+	static const GLsizei stride = First::size + VertexFormat<Rest...>::stride;
+
+	// whether some attribute feeds the location
+	template <GLuint Location>
+	static constexpr bool has()
+	{
+		return (!First::padding && First::location == Location) || VertexFormat<Rest...>::template has<Location>();
+	}
+
+	// byte offset of the attribute at the location within the vertex; check has() first
+	template <GLuint Location>
+	static constexpr GLuint offsetOf()
+	{
+		return !First::padding && First::location == Location ? 0 : First::size + VertexFormat<Rest...>::template offsetOf<Location>();
+	}
+
+	static void appendAttributes(std::vector<VertexAttribute>& attributes, GLuint offset)
+	{
+		appendAttribute<First>(attributes, offset);
+		VertexFormat<Rest...>::appendAttributes(attributes, offset + First::size);
+	}
+
+	static VertexLayout layout()
+	{
+		VertexLayout result;
+		result.stride = stride;
+		appendAttributes(result.attributes, 0);
+		return result;
+	}
+
+	// attribute pointers for the buffer bound to GL_ARRAY_BUFFER, in the bound VAO
+	static void setup(GLuint baseOffset = 0)
+	{
+		setupVertexAttributes(layout(), baseOffset);
+	}
+
+private:
+	template <typename A>
+	static typename std::enable_if<!A::padding>::type appendAttribute(std::vector<VertexAttribute>& attributes, GLuint offset)
+	{
+		VertexAttribute attribute = { A::location, A::components, offset, A::type, A::normalized };
+		attributes.push_back(attribute);
+	}
+
+	template <typename A>
+	static typename std::enable_if<A::padding>::type appendAttribute(std::vector<VertexAttribute>&, GLuint)
+	{
+	}
+};
+
+// A vertex split over several buffers, one VertexFormat per stream. The streams are indexed in
+// step, so an index buffer and base vertex address all of them at once.
+template <typename... Formats>
+struct VertexStreams
+{
+	static const size_t count = sizeof...(Formats);
+
+	static std::vector<VertexLayout> layouts()
+	{
+		return { Formats::layout()... };
+	}
+
+	// binds buffers[i] as stream i and sets up its attributes, in the bound VAO
+	static void setup(const GLuint* buffers)
+	{
+		setupFirst(buffers, count);
+	}
+
+	// sets up only the first `streams` streams, e.g. the position stream of a depth-only VAO
+	static void setupFirst(const GLuint* buffers, size_t streams)
+	{
+		std::vector<VertexLayout> all = layouts();
+		for (size_t i = 0; i < streams && i < all.size(); i++)
+		{
+			glState().bindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+			setupVertexAttributes(all[i]);
+		}
+	}
+};
+#endif
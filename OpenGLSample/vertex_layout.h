@@ -0,0 +1,48 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// one attribute of an interleaved vertex; float attributes only need the first three fields
+struct VertexAttribute
+{
+	GLuint index;
+	GLint components;
+	GLuint offset;                  // bytes from the start of the vertex
+	GLenum type = GL_FLOAT;
+	GLboolean normalized = GL_FALSE; // integer types read as [0, 1] / [-1, 1] in the shader
+};
+
+struct VertexLayout
+{
+	GLsizei stride;
+	std::vector<VertexAttribute> attributes;
+
+	bool operator==(const VertexLayout& other) const
+	{
+		if (stride != other.stride || attributes.size() != other.attributes.size())
+			return false;
+		for (size_t i = 0; i < attributes.size(); i++)
+		{
+			const VertexAttribute& a = attributes[i];
+			const VertexAttribute& b = other.attributes[i];
+			if (a.index != b.index || a.components != b.components || a.offset != b.offset
+				|| a.type != b.type || a.normalized != b.normalized)
+				return false;
+		}
+		return true;
+	}
+};
+
+// How the vertex shader turns a mesh's stored attributes back into object space: position =
+// stored * scale + bias, and octahedral normals are unfolded. Float meshes use the identity.
+struct VertexDecode
+{
+	float positionScale[3] = { 1.0f, 1.0f, 1.0f };
+	float positionBias[3] = { 0.0f, 0.0f, 0.0f };
+	bool octahedralNormals = false;
+};
+#endif
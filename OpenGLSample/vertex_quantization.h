@@ -0,0 +1,257 @@
+#ifndef VERTEX_QUANTIZATION_H
+#define VERTEX_QUANTIZATION_H
+
+#include <glad/glad.h>
+
+#include "mesh_processing.h"
+#include "vertex_layout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// Packs float vertices into a compact format the vertex shader unpacks on the fly:
+//   position   4 x unorm16, relative to the mesh bounds (w holds the bitangent sign)
+//   normal     2 x snorm16, octahedral
+//   uv         2 x half float
+//   tangent    2 x snorm16, octahedral (only when the source has one)
+// That is 16 bytes for the procedural position/normal/uv vertex (32 as floats) and 20 bytes
+// for mesh.h's Vertex (56 as floats). Integer attributes are fetched normalized, so positions
+// arrive in [0, 1] and are scaled back with the mesh's VertexDecode, which the scene stores
+// per object; half floats need no decoding at all.
+
+// where the attributes sit in a float vertex, in floats; -1 when absent. Position is always at 0.
+struct QuantizeSource
+{
+	int normal = -1;
+	int uv = -1;
+	int tangent = -1;
+	int bitangent = -1;     // only its handedness is kept
+	GLuint normalLocation = 1;
+	GLuint uvLocation = 2;
+	GLuint tangentLocation = 3;
+};
+
+// reads the roles off a float layout: after the position, the first 3-component attribute is the
+// normal, the 2-component one the UV, and further 3-component ones the tangent and bitangent
+// (the order of mesh.h's Vertex)
+inline QuantizeSource quantizeSourceFor(const VertexLayout& layout)
+{
+	QuantizeSource source;
+	for (const VertexAttribute& attribute : layout.attributes)
+	{
+		int offset = (int)(attribute.offset / sizeof(float));
+		if (offset == 0)
+			continue;
+		if (attribute.components == 2 && source.uv < 0)
+		{
+			source.uv = offset;
+			source.uvLocation = attribute.index;
+		}
+		else if (attribute.components == 3 && source.normal < 0)
+		{
+			source.normal = offset;
+			source.normalLocation = attribute.index;
+		}
+		else if (attribute.components == 3 && source.tangent < 0)
+		{
+			source.tangent = offset;
+			source.tangentLocation = attribute.index;
+		}
+		else if (attribute.components == 3 && source.bitangent < 0)
+			source.bitangent = offset;
+	}
+	return source;
+}
+
+// a packed mesh, ready for MeshPool::add
+struct QuantizedMesh
+{
+	VertexLayout layout;
+	std::vector<unsigned char> vertices;
+	std::vector<uint32_t> indices;
+	uint32_t vertexCount = 0;
+	VertexDecode decode;
+
+	GLenum indexType() const
+	{
+		return indexTypeFor(vertexCount);
+	}
+};
+
+// IEEE half from float, rounded to nearest; overflow goes to infinity, tiny values to denormals
+inline uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, 4);
+	uint32_t sign = (bits >> 16) & 0x8000u;
+	int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFFu;
+
+	if (((bits >> 23) & 0xFF) == 0xFF)
+		return (uint16_t)(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+	if (exponent >= 31)
+		return (uint16_t)(sign | 0x7C00u);
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return (uint16_t)sign;
+		mantissa |= 0x800000u;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1u)))
+			half++;
+		return (uint16_t)(sign | half);
+	}
+	uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1FFFu;
+	// a carry out of the mantissa correctly bumps the exponent
+	if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+		half++;
+	return (uint16_t)half;
+}
+
+inline int16_t toSnorm16(float value)
+{
+	return (int16_t)std::lround(std::max(-1.0f, std::min(1.0f, value)) * 32767.0f);
+}
+
+// unit vector to the octahedron folded onto the unit square, two snorm16
+inline void octahedralEncode(const float* direction, int16_t* encoded)
+{
+	float l1 = std::fabs(direction[0]) + std::fabs(direction[1]) + std::fabs(direction[2]);
+	if (l1 <= 0.0f)
+	{
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+	float x = direction[0] / l1;
+	float y = direction[1] / l1;
+	if (direction[2] < 0.0f)
+	{
+		float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+	encoded[0] = toSnorm16(x);
+	encoded[1] = toSnorm16(y);
+}
+
+inline QuantizedMesh quantizeMesh(const IndexedMesh& mesh, const QuantizeSource& source)
+{
+	QuantizedMesh result;
+	result.indices = mesh.indices;
+	result.vertexCount = mesh.vertexCount();
+	uint32_t count = result.vertexCount;
+	const float* vertices = mesh.vertices.data();
+	uint32_t floats = mesh.floatsPerVertex;
+
+	// bounds; a flat axis still gets a non-zero extent so decoding never divides by zero
+	float minimum[3] = { 0.0f, 0.0f, 0.0f };
+	float extent[3] = { 1.0f, 1.0f, 1.0f };
+	for (uint32_t axis = 0; axis < 3 && count > 0; axis++)
+	{
+		float low = vertices[axis], high = vertices[axis];
+		for (uint32_t v = 1; v < count; v++)
+		{
+			low = std::min(low, vertices[(size_t)v * floats + axis]);
+			high = std::max(high, vertices[(size_t)v * floats + axis]);
+		}
+		minimum[axis] = low;
+		extent[axis] = high > low ? high - low : 1.0f;
+	}
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		result.decode.positionScale[axis] = extent[axis];
+		result.decode.positionBias[axis] = minimum[axis];
+	}
+	result.decode.octahedralNormals = source.normal >= 0;
+
+	// attribute placement
+	uint32_t stride = 8;
+	result.layout.attributes.push_back({ 0, source.tangent >= 0 ? 4 : 3, 0, GL_UNSIGNED_SHORT, GL_TRUE });
+	uint32_t normalOffset = stride, uvOffset = 0, tangentOffset = 0;
+	if (source.normal >= 0)
+	{
+		result.layout.attributes.push_back({ source.normalLocation, 2, stride, GL_SHORT, GL_TRUE });
+		stride += 4;
+	}
+	if (source.uv >= 0)
+	{
+		uvOffset = stride;
+		result.layout.attributes.push_back({ source.uvLocation, 2, stride, GL_HALF_FLOAT, GL_FALSE });
+		stride += 4;
+	}
+	if (source.tangent >= 0)
+	{
+		tangentOffset = stride;
+		result.layout.attributes.push_back({ source.tangentLocation, 2, stride, GL_SHORT, GL_TRUE });
+		stride += 4;
+	}
+	result.layout.stride = stride;
+
+	result.vertices.assign((size_t)count * stride, 0);
+	for (uint32_t v = 0; v < count; v++)
+	{
+		const float* vertex = vertices + (size_t)v * floats;
+		unsigned char* packed = &result.vertices[(size_t)v * stride];
+
+		uint16_t position[4] = { 0, 0, 0, 0 };
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			float normalized = (vertex[axis] - minimum[axis]) / extent[axis];
+			position[axis] = (uint16_t)std::lround(std::max(0.0f, std::min(1.0f, normalized)) * 65535.0f);
+		}
+		if (source.tangent >= 0)
+		{
+			// bitangent = cross(normal, tangent) * sign; w reads as 0 (negative) or 1 (positive)
+			float sign = 1.0f;
+			if (source.bitangent >= 0 && source.normal >= 0)
+			{
+				const float* n = vertex + source.normal;
+				const float* t = vertex + source.tangent;
+				const float* b = vertex + source.bitangent;
+				float cross[3] = { n[1] * t[2] - n[2] * t[1], n[2] * t[0] - n[0] * t[2], n[0] * t[1] - n[1] * t[0] };
+				sign = cross[0] * b[0] + cross[1] * b[1] + cross[2] * b[2] < 0.0f ? -1.0f : 1.0f;
+			}
+			position[3] = sign < 0.0f ? 0 : 65535;
+		}
+		memcpy(packed, position, sizeof(position));
+
+		if (source.normal >= 0)
+		{
+			int16_t normal[2];
+			octahedralEncode(vertex + source.normal, normal);
+			memcpy(packed + normalOffset, normal, sizeof(normal));
+		}
+		if (source.uv >= 0)
+		{
+			uint16_t uv[2] = { floatToHalf(vertex[source.uv]), floatToHalf(vertex[source.uv + 1]) };
+			memcpy(packed + uvOffset, uv, sizeof(uv));
+		}
+		if (source.tangent >= 0)
+		{
+			int16_t tangent[2];
+			octahedralEncode(vertex + source.tangent, tangent);
+			memcpy(packed + tangentOffset, tangent, sizeof(tangent));
+		}
+	}
+
+	// memory, and the bytes one draw of the mesh fetches through the post-transform cache
+	uint64_t transforms = simulateVertexCache(mesh.indices, count);
+	std::lock_guard<std::mutex> lock(meshProcessingStatsMutex());
+	MeshProcessingStats& stats = meshProcessingStats();
+	stats.quantizedMeshes++;
+	stats.floatVertexBytes += mesh.vertices.size() * sizeof(float);
+	stats.packedVertexBytes += result.vertices.size();
+	stats.floatFetchBytes += transforms * floats * sizeof(float);
+	stats.packedFetchBytes += transforms * stride;
+	return result;
+}
+#endif